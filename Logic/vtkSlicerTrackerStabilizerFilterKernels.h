@@ -0,0 +1,695 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerTrackerStabilizerFilterKernels - filter inner loops
+// .SECTION Description
+// Filter steps written as templates over the scalar type (float or double)
+// and the algorithm, so that the logic selects a specialization once when a
+// filter is configured instead of branching for every sample.
+// A pose is a unit quaternion (w, x, y, z) and a position.
+// The batched kernels work on structure-of-arrays buffers (component c of
+// tool i at c*stride + i). The slerp transcendentals keep the loop over
+// tools scalar: with GCC -O2 on x86-64 the float batch is only about 4%
+// faster than double (see vtkSlicerTrackerStabilizerKernelPrecisionBenchmark).
+
+#ifndef __vtkSlicerTrackerStabilizerFilterKernels_h
+#define __vtkSlicerTrackerStabilizerFilterKernels_h
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace vtkSlicerTrackerStabilizerFilterKernels
+{
+
+enum Algorithms
+{
+  PassThroughAlgorithm = 0,
+  LowPassAlgorithm,
+  FastLowPassAlgorithm
+};
+
+// Maximum number of terms of the slerp polynomial
+const int MaximumNumberOfSlerpTerms = 24;
+
+enum SmoothingMethods
+{
+  ForwardBackwardSmoothing = 0,
+  RauchTungStriebelSmoothing
+};
+
+//----------------------------------------------------------------------------
+// Weight of the input sample of a first-order low-pass filter with a cutoff
+// frequency, for samples dt apart
+template <typename Real>
+inline Real BlendFactorFromCutOffFrequency(Real cutOffFrequency, Real dt)
+{
+  const Real weightCurrent = dt*cutOffFrequency;
+  return weightCurrent / (Real(1) + weightCurrent);
+}
+
+//----------------------------------------------------------------------------
+template <typename Real>
+inline void NormalizeQuaternion(Real quaternion[4])
+{
+  const Real norm = Real(1) / std::sqrt(quaternion[0]*quaternion[0] + quaternion[1]*quaternion[1] +
+                                        quaternion[2]*quaternion[2] + quaternion[3]*quaternion[3]);
+  for (int i = 0; i < 4; ++i)
+    {
+    quaternion[i] *= norm;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Spherical linear interpolation along the shortest path. Quaternions equal
+// to the precision of Real are interpolated linearly, which is then exact.
+// Also used by vtkSlicerTrackerStabilizerLogic::Slerp and the transform
+// interpolation. result may alias from or to.
+template <typename Real>
+inline void Slerp(Real result[4], Real t, const Real from[4], const Real to[4])
+{
+  Real cosom = from[0]*to[0] + from[1]*to[1] + from[2]*to[2] + from[3]*to[3];
+  const Real sign = (cosom < Real(0)) ? Real(-1) : Real(1);
+  cosom *= sign;
+
+  const bool linear = (Real(1) - cosom) <= std::numeric_limits<Real>::epsilon();
+  const Real omega = std::acos(linear ? Real(0) : cosom);
+  const Real sinom = linear ? Real(1) : std::sin(omega);
+  const Real sclp = linear ? Real(1) - t : std::sin((Real(1) - t)*omega) / sinom;
+  const Real sclq = sign * (linear ? t : std::sin(t*omega) / sinom);
+
+  for (int i = 0; i < 4; ++i)
+    {
+    result[i] = sclp*from[i] + sclq*to[i];
+    }
+}
+
+//----------------------------------------------------------------------------
+// Slerp without transcendental functions (D. Eberly, "A fast and accurate
+// algorithm for computing SLERP"). With x = cos(angle), the weights
+// sin(t*angle)/sin(angle) are expanded as sum b_i(t) (x - 1)^i, where
+//   b_0(t) = t, b_i(t) = b_{i-1}(t) (t^2 - i^2) / (i (2i + 1))
+// The coefficients only depend on t, which is the same for every sample of
+// a filter at rest, so they are computed once. With no terms, the
+// quaternions are linearly interpolated and renormalized (nlerp).
+template <typename Real>
+struct SlerpCoefficients
+{
+  SlerpCoefficients() : NumberOfTerms(0), T(0) {}
+
+  void Set(Real t, int numberOfTerms)
+  {
+    this->NumberOfTerms = numberOfTerms;
+    this->T = t;
+    Real from = Real(1) - t;
+    Real to = t;
+    for (int i = 0; i < numberOfTerms; ++i)
+      {
+      this->From[i] = from;
+      this->To[i] = to;
+      const Real n = Real(i + 1);
+      const Real d = n*(Real(2)*n + Real(1));
+      from *= ((Real(1) - t)*(Real(1) - t) - n*n) / d;
+      to *= (t*t - n*n) / d;
+      }
+  }
+
+  int NumberOfTerms;
+  Real T;
+  Real From[MaximumNumberOfSlerpTerms];
+  Real To[MaximumNumberOfSlerpTerms];
+};
+
+//----------------------------------------------------------------------------
+// Approximate slerp along the shortest path. result may alias from or to.
+template <typename Real>
+inline void FastSlerp(Real result[4], const SlerpCoefficients<Real>& coefficients,
+                      const Real from[4], const Real to[4])
+{
+  Real cosom = from[0]*to[0] + from[1]*to[1] + from[2]*to[2] + from[3]*to[3];
+  const Real sign = (cosom < Real(0)) ? Real(-1) : Real(1);
+  cosom *= sign;
+
+  if (coefficients.NumberOfTerms == 0)
+    {
+    const Real sclp = Real(1) - coefficients.T;
+    const Real sclq = sign * coefficients.T;
+    Real norm = 0;
+    for (int i = 0; i < 4; ++i)
+      {
+      result[i] = sclp*from[i] + sclq*to[i];
+      norm += result[i]*result[i];
+      }
+    norm = Real(1) / std::sqrt(norm);
+    for (int i = 0; i < 4; ++i)
+      {
+      result[i] *= norm;
+      }
+    return;
+    }
+
+  // Horner evaluation of both weights
+  const Real x = cosom - Real(1);
+  const int last = coefficients.NumberOfTerms - 1;
+  Real sclp = coefficients.From[last];
+  Real sclq = coefficients.To[last];
+  for (int i = last - 1; i >= 0; --i)
+    {
+    sclp = coefficients.From[i] + x*sclp;
+    sclq = coefficients.To[i] + x*sclq;
+    }
+  sclq *= sign;
+
+  for (int i = 0; i < 4; ++i)
+    {
+    result[i] = sclp*from[i] + sclq*to[i];
+    }
+}
+
+//----------------------------------------------------------------------------
+// Smallest number of terms for which FastSlerp stays within tolerance of
+// Slerp (euclidean distance between quaternions) for any t in [0, 1] and any
+// angle between the quaternions. 0 means nlerp is accurate enough. Returns -1
+// if the tolerance cannot be met, in which case Slerp must be used.
+inline int SelectNumberOfSlerpTerms(double tolerance)
+{
+  const int numberOfAngles = 91;
+  const int numberOfWeights = 17;
+  for (int numberOfTerms = 0; numberOfTerms <= MaximumNumberOfSlerpTerms; ++numberOfTerms)
+    {
+    double maximumError = 0.0;
+    for (int j = 0; j < numberOfWeights; ++j)
+      {
+      const double t = static_cast<double>(j) / (numberOfWeights - 1);
+      SlerpCoefficients<double> coefficients;
+      coefficients.Set(t, numberOfTerms);
+      for (int k = 0; k < numberOfAngles; ++k)
+        {
+        // Angles up to 180 degrees between rotations (90 between quaternions)
+        const double angle = 0.5 * 3.14159265358979323846 * k / (numberOfAngles - 1);
+        const double from[4] = {1.0, 0.0, 0.0, 0.0};
+        const double to[4] = {std::cos(angle), std::sin(angle), 0.0, 0.0};
+        double exact[4];
+        double approximate[4];
+        Slerp(exact, t, from, to);
+        FastSlerp(approximate, coefficients, from, to);
+        double error = 0.0;
+        for (int i = 0; i < 4; ++i)
+          {
+          error += (exact[i] - approximate[i])*(exact[i] - approximate[i]);
+          }
+        maximumError = std::max(maximumError, std::sqrt(error));
+        }
+      }
+    if (maximumError <= tolerance)
+      {
+      return numberOfTerms;
+      }
+    }
+  return -1;
+}
+
+//----------------------------------------------------------------------------
+// Move the position towards the input, with one weight per translation axis.
+// The axes are those of the parent (camera) frame when toolFrame is 0 and
+// those of the filtered tool frame when it is 1; the frame is blended rather
+// than selected so that the step has no branch.
+template <typename Real>
+inline void TranslationStep(const Real alpha[3], Real toolFrame, const Real quaternion[4],
+                            const Real inputPosition[3], Real position[3])
+{
+  const Real w = quaternion[0], x = quaternion[1], y = quaternion[2], z = quaternion[3];
+  const Real rotation[3][3] =
+    {
+      { Real(1) - Real(2)*(y*y + z*z), Real(2)*(x*y - w*z), Real(2)*(x*z + w*y) },
+      { Real(2)*(x*y + w*z), Real(1) - Real(2)*(x*x + z*z), Real(2)*(y*z - w*x) },
+      { Real(2)*(x*z - w*y), Real(2)*(y*z + w*x), Real(1) - Real(2)*(x*x + y*y) }
+    };
+  Real frame[3][3];
+  for (int i = 0; i < 3; ++i)
+    {
+    for (int j = 0; j < 3; ++j)
+      {
+      const Real identity = (i == j) ? Real(1) : Real(0);
+      frame[i][j] = identity + toolFrame*(rotation[i][j] - identity);
+      }
+    }
+
+  // Weighted difference in the frame axes, back to the parent frame
+  Real local[3];
+  for (int j = 0; j < 3; ++j)
+    {
+    local[j] = alpha[j] * (frame[0][j]*(inputPosition[0] - position[0]) +
+                           frame[1][j]*(inputPosition[1] - position[1]) +
+                           frame[2][j]*(inputPosition[2] - position[2]));
+    }
+  for (int i = 0; i < 3; ++i)
+    {
+    position[i] += frame[i][0]*local[0] + frame[i][1]*local[1] + frame[i][2]*local[2];
+    }
+}
+
+//----------------------------------------------------------------------------
+// Algorithms. Step moves the filter state (quaternion, position) towards the
+// input sample. alpha holds the weights of the input sample for the rotation
+// and for the three translation axes, toolFrame selects the translation axes
+// (see TranslationStep).
+
+struct PassThroughFilter
+{
+  static const int Algorithm = PassThroughAlgorithm;
+
+  template <typename Real>
+  static inline void Step(const Real[4], Real, const Real inputQuaternion[4], const Real inputPosition[3],
+                          Real quaternion[4], Real position[3])
+  {
+    for (int i = 0; i < 4; ++i)
+      {
+      quaternion[i] = inputQuaternion[i];
+      }
+    for (int i = 0; i < 3; ++i)
+      {
+      position[i] = inputPosition[i];
+      }
+  }
+};
+
+struct LowPassFilter
+{
+  static const int Algorithm = LowPassAlgorithm;
+
+  template <typename Real>
+  static inline void Step(const Real alpha[4], Real toolFrame,
+                          const Real inputQuaternion[4], const Real inputPosition[3],
+                          Real quaternion[4], Real position[3])
+  {
+    Slerp(quaternion, alpha[0], quaternion, inputQuaternion);
+    TranslationStep(alpha + 1, toolFrame, quaternion, inputPosition, position);
+  }
+};
+
+// Low-pass filter using FastSlerp. The rotation blend factor is
+// coefficients.T, alpha[0] is not used.
+struct FastLowPassFilter
+{
+  static const int Algorithm = FastLowPassAlgorithm;
+
+  template <typename Real>
+  static inline void Step(const SlerpCoefficients<Real>& coefficients,
+                          const Real alpha[4], Real toolFrame,
+                          const Real inputQuaternion[4], const Real inputPosition[3],
+                          Real quaternion[4], Real position[3])
+  {
+    FastSlerp(quaternion, coefficients, quaternion, inputQuaternion);
+    TranslationStep(alpha + 1, toolFrame, quaternion, inputPosition, position);
+  }
+};
+
+//----------------------------------------------------------------------------
+// One step of one filter
+template <typename Real, class Algorithm>
+void FilterStep(const Real alpha[4], Real toolFrame,
+                const Real inputQuaternion[4], const Real inputPosition[3],
+                Real quaternion[4], Real position[3])
+{
+  Algorithm::Step(alpha, toolFrame, inputQuaternion, inputPosition, quaternion, position);
+}
+
+//----------------------------------------------------------------------------
+// One step of any algorithm. The slerp coefficients are only used by the
+// fast low-pass filter, which sets them again when the rotation weight
+// changes; they are usually the same from one sample to the next.
+template <typename Real, class Algorithm>
+void FilterStep(Algorithm, SlerpCoefficients<Real>&, const Real alpha[4], Real toolFrame,
+                const Real inputQuaternion[4], const Real inputPosition[3],
+                Real quaternion[4], Real position[3])
+{
+  Algorithm::Step(alpha, toolFrame, inputQuaternion, inputPosition, quaternion, position);
+}
+
+template <typename Real>
+void FilterStep(FastLowPassFilter, SlerpCoefficients<Real>& coefficients, const Real alpha[4],
+                Real toolFrame, const Real inputQuaternion[4], const Real inputPosition[3],
+                Real quaternion[4], Real position[3])
+{
+  if (alpha[0] != coefficients.T)
+    {
+    coefficients.Set(alpha[0], coefficients.NumberOfTerms);
+    }
+  FastLowPassFilter::Step(coefficients, alpha, toolFrame,
+                          inputQuaternion, inputPosition, quaternion, position);
+}
+
+//----------------------------------------------------------------------------
+// Number of filter steps between two renormalizations of the filtered
+// quaternion of a live filter. Each step only adds rounding errors (or the
+// bounded error of the fast slerp for large angles), so the drift stays
+// negligible.
+const unsigned int NormalizationInterval = 64;
+
+//----------------------------------------------------------------------------
+// Count a step of a live filter and renormalize its quaternion every
+// interval steps
+template <typename Real>
+inline void NormalizePeriodically(Real quaternion[4], unsigned int& stepsSinceNormalization,
+                                  unsigned int interval = NormalizationInterval)
+{
+  if (++stepsSinceNormalization >= interval)
+    {
+    NormalizeQuaternion(quaternion);
+    stepsSinceNormalization = 0;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Store a quaternion in a filter state, with the sign that keeps it in the
+// hemisphere of the previous one
+template <typename Real>
+inline void SetQuaternionInHemisphere(Real quaternion[4], const Real newQuaternion[4])
+{
+  const Real sign = (quaternion[0]*newQuaternion[0] + quaternion[1]*newQuaternion[1] +
+                     quaternion[2]*newQuaternion[2] + quaternion[3]*newQuaternion[3] < Real(0)) ?
+    Real(-1) : Real(1);
+  for (int i = 0; i < 4; ++i)
+    {
+    quaternion[i] = sign*newQuaternion[i];
+    }
+}
+
+//----------------------------------------------------------------------------
+// Whether the filter state is within the convergence tolerances of the input
+// (squared distance, and 1 - cos(angle/2)), in which case it is snapped to
+// the input, in the hemisphere of the state
+template <typename Real>
+inline bool SnapToInput(const Real inputQuaternion[4], const Real inputPosition[3],
+                        Real positionTolerance2, Real dotTolerance,
+                        Real quaternion[4], Real position[3])
+{
+  const Real cosHalfAngle = std::abs(
+    inputQuaternion[0]*quaternion[0] + inputQuaternion[1]*quaternion[1] +
+    inputQuaternion[2]*quaternion[2] + inputQuaternion[3]*quaternion[3]);
+  Real distance2 = Real(0);
+  for (int i = 0; i < 3; ++i)
+    {
+    distance2 += (inputPosition[i] - position[i])*(inputPosition[i] - position[i]);
+    }
+  if (distance2 > positionTolerance2 || Real(1) - cosHalfAngle > dotTolerance)
+    {
+    return false;
+    }
+  SetQuaternionInHemisphere(quaternion, inputQuaternion);
+  for (int i = 0; i < 3; ++i)
+    {
+    position[i] = inputPosition[i];
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Filter of a recorded pose sequence. The weights of each sample are
+// computed from its time step, so that irregular or dropped samples are
+// filtered with the same cutoff frequencies. The quaternion is renormalized
+// at every step.
+template <typename Real, class Algorithm>
+struct SequenceFilter
+{
+  SequenceFilter() : ToolFrame(0), LastTime(0), DefaultTimeStep(0), Initialized(false)
+  {
+    for (int i = 0; i < 4; ++i)
+      {
+      this->CutOffFrequencies[i] = 0;
+      }
+  }
+
+  // Cutoff frequencies of the rotation then the translation axes, time step
+  // used when the times do not increase
+  void Configure(const Real cutOffFrequencies[4], Real toolFrame, int numberOfSlerpTerms,
+                 double defaultTimeStep)
+  {
+    for (int i = 0; i < 4; ++i)
+      {
+      this->CutOffFrequencies[i] = cutOffFrequencies[i];
+      }
+    this->ToolFrame = toolFrame;
+    this->DefaultTimeStep = defaultTimeStep;
+    this->Coefficients.Set(BlendFactorFromCutOffFrequency(cutOffFrequencies[0], Real(defaultTimeStep)),
+                           std::max(numberOfSlerpTerms, 0));
+    this->Initialized = false;
+  }
+
+  // Start again at the next sample
+  void Reset()
+  {
+    this->Initialized = false;
+  }
+
+  // Filter one sample, the output is Quaternion and Position
+  void Step(double time, const Real inputQuaternion[4], const Real inputPosition[3])
+  {
+    if (!this->Initialized)
+      {
+      this->Initialized = true;
+      this->LastTime = time;
+      const Real sign = (inputQuaternion[0] < Real(0)) ? Real(-1) : Real(1);
+      for (int i = 0; i < 4; ++i)
+        {
+        this->Quaternion[i] = sign*inputQuaternion[i];
+        }
+      for (int i = 0; i < 3; ++i)
+        {
+        this->Position[i] = inputPosition[i];
+        }
+      return;
+      }
+
+    const double dt = (time > this->LastTime) ? time - this->LastTime : this->DefaultTimeStep;
+    this->LastTime = time;
+    Real alpha[4];
+    for (int i = 0; i < 4; ++i)
+      {
+      alpha[i] = BlendFactorFromCutOffFrequency(this->CutOffFrequencies[i], Real(dt));
+      }
+    FilterStep(Algorithm(), this->Coefficients, alpha, this->ToolFrame,
+               inputQuaternion, inputPosition, this->Quaternion, this->Position);
+    NormalizeQuaternion(this->Quaternion);
+  }
+
+  Real CutOffFrequencies[4];
+  Real ToolFrame;
+  SlerpCoefficients<Real> Coefficients;
+  double LastTime;
+  double DefaultTimeStep;
+  bool Initialized;
+  Real Quaternion[4];
+  Real Position[3];
+};
+
+//----------------------------------------------------------------------------
+// Filter count samples of a sequence (quaternions 4 per sample, positions 3
+// per sample, times in seconds). The outputs may be the inputs.
+template <typename Real, class Algorithm>
+void FilterSequence(SequenceFilter<Real, Algorithm>& filter, size_t count, const double* times,
+                    const Real* inputQuaternions, const Real* inputPositions,
+                    Real* quaternions, Real* positions)
+{
+  for (size_t i = 0; i < count; ++i)
+    {
+    filter.Step(times[i], inputQuaternions + 4*i, inputPositions + 3*i);
+    for (int c = 0; c < 4; ++c)
+      {
+      quaternions[4*i + c] = filter.Quaternion[c];
+      }
+    for (int c = 0; c < 3; ++c)
+      {
+      positions[3*i + c] = filter.Position[c];
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// One step of the tools [begin, end) stored as structure of arrays. Not
+// vectorized, each tool is stepped with the scalar kernel.
+template <typename Real, class Algorithm>
+void FilterBatch(size_t begin, size_t end, size_t stride,
+                 const Real* alphas, const Real* toolFrames,
+                 const Real* inputQuaternions, const Real* inputPositions,
+                 Real* quaternions, Real* positions)
+{
+  for (size_t i = begin; i < end; ++i)
+    {
+    Real alpha[4];
+    Real inputQuaternion[4];
+    Real quaternion[4];
+    for (int c = 0; c < 4; ++c)
+      {
+      alpha[c] = alphas[c*stride + i];
+      inputQuaternion[c] = inputQuaternions[c*stride + i];
+      quaternion[c] = quaternions[c*stride + i];
+      }
+    Real inputPosition[3];
+    Real position[3];
+    for (int c = 0; c < 3; ++c)
+      {
+      inputPosition[c] = inputPositions[c*stride + i];
+      position[c] = positions[c*stride + i];
+      }
+
+    Algorithm::Step(alpha, toolFrames[i], inputQuaternion, inputPosition, quaternion, position);
+
+    for (int c = 0; c < 4; ++c)
+      {
+      quaternions[c*stride + i] = quaternion[c];
+      }
+    for (int c = 0; c < 3; ++c)
+      {
+      positions[c*stride + i] = position[c];
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Non-causal smoothing of count samples of a sequence, in place in
+// quaternions and positions (4 and 3 per sample), for offline data:
+// - ForwardBackwardSmoothing runs the low-pass filter forward then backward
+//   over the forward output, which cancels its phase shift (zero lag). The
+//   attenuation is applied twice, so the response is that of the filter
+//   squared.
+// - RauchTungStriebelSmoothing runs a Kalman filter forward, then the RTS
+//   backward pass. The model is a local level (random walk of the pose with
+//   white measurement noise) for the rotation and each translation axis; the
+//   ratio of process to measurement noise is chosen so that the steady
+//   state gain of the forward pass at defaultTimeStep is the low-pass weight
+//   of the cutoff frequency. gains holds 4 values per sample.
+// Both passes are slerp steps of the low-pass filter, with the weights of
+// each sample computed from the time steps.
+template <typename Real>
+void SmoothSequence(int method, size_t count, const double* times,
+                    const Real cutOffFrequencies[4], Real toolFrame, double defaultTimeStep,
+                    Real* quaternions, Real* positions, Real* gains)
+{
+  if (count < 2)
+    {
+    return;
+    }
+  const bool kalman = (method == RauchTungStriebelSmoothing);
+  Real noiseRatioRates[4];  // (process noise / time) / measurement noise
+  Real variances[4];        // Filtered state variance / measurement noise
+  for (int c = 0; c < 4; ++c)
+    {
+    const Real gain = BlendFactorFromCutOffFrequency(cutOffFrequencies[c], Real(defaultTimeStep));
+    noiseRatioRates[c] = (gain < Real(1)) ? gain*gain / ((Real(1) - gain)*Real(defaultTimeStep)) : Real(0);
+    variances[c] = Real(1);
+    }
+
+  // Forward pass, from the first sample
+  Real quaternion[4];
+  Real position[3];
+  for (int i = 0; i < 4; ++i)
+    {
+    quaternion[i] = quaternions[i];
+    }
+  for (int i = 0; i < 3; ++i)
+    {
+    position[i] = positions[i];
+    }
+  for (size_t k = 1; k < count; ++k)
+    {
+    const double dt = (times[k] > times[k - 1]) ? times[k] - times[k - 1] : defaultTimeStep;
+    Real alpha[4];
+    for (int c = 0; c < 4; ++c)
+      {
+      if (kalman)
+        {
+        const Real predicted = variances[c] + noiseRatioRates[c]*Real(dt);
+        alpha[c] = predicted / (predicted + Real(1));
+        // Backward gain of the previous sample: filtered / predicted variance
+        gains[4*(k - 1) + c] = variances[c] / predicted;
+        variances[c] = (Real(1) - alpha[c])*predicted;
+        }
+      else
+        {
+        alpha[c] = BlendFactorFromCutOffFrequency(cutOffFrequencies[c], Real(dt));
+        }
+      }
+    LowPassFilter::Step(alpha, toolFrame, quaternions + 4*k, positions + 3*k, quaternion, position);
+    NormalizeQuaternion(quaternion);
+    for (int i = 0; i < 4; ++i)
+      {
+      quaternions[4*k + i] = quaternion[i];
+      }
+    for (int i = 0; i < 3; ++i)
+      {
+      positions[3*k + i] = position[i];
+      }
+    }
+
+  // Backward pass, from the last forward output
+  for (size_t k = count - 1; k-- > 0; )
+    {
+    Real alpha[4];
+    Real* forwardQuaternion = quaternions + 4*k;
+    Real* forwardPosition = positions + 3*k;
+    if (kalman)
+      {
+      // Smoothed = filtered + gain * (next smoothed - filtered), the next
+      // smoothed pose is in quaternion and position
+      for (int c = 0; c < 4; ++c)
+        {
+        alpha[c] = gains[4*k + c];
+        }
+      LowPassFilter::Step(alpha, toolFrame, quaternion, position, forwardQuaternion, forwardPosition);
+      NormalizeQuaternion(forwardQuaternion);
+      for (int i = 0; i < 4; ++i)
+        {
+        quaternion[i] = forwardQuaternion[i];
+        }
+      for (int i = 0; i < 3; ++i)
+        {
+        position[i] = forwardPosition[i];
+        }
+      }
+    else
+      {
+      const double dt = (times[k + 1] > times[k]) ? times[k + 1] - times[k] : defaultTimeStep;
+      for (int c = 0; c < 4; ++c)
+        {
+        alpha[c] = BlendFactorFromCutOffFrequency(cutOffFrequencies[c], Real(dt));
+        }
+      LowPassFilter::Step(alpha, toolFrame, forwardQuaternion, forwardPosition, quaternion, position);
+      NormalizeQuaternion(quaternion);
+      for (int i = 0; i < 4; ++i)
+        {
+        forwardQuaternion[i] = quaternion[i];
+        }
+      for (int i = 0; i < 3; ++i)
+        {
+        forwardPosition[i] = position[i];
+        }
+      }
+    }
+}
+
+}
+
+#endif
@@ -21,275 +21,3116 @@
 ==============================================================================*/
 
 // TrackerStabilizer Logic includes
+#include "vtkSlicerTrackerStabilizerFilterKernels.h"
 #include "vtkSlicerTrackerStabilizerLogic.h"
+#include "vtkSlicerTrackerStabilizerTrace.h"
+
+// TrackerStabilizer SharedMemory and Network includes
+#include "TrackerStabilizerNetwork.h"
+#include "TrackerStabilizerSharedMemory.h"
 
 // MRML includes
+#ifdef TrackerStabilizer_USE_SEQUENCES
+#include <vtkMRMLSequenceNode.h>
+#endif
 
 // VTK includes
+#include <vtkDoubleArray.h>
 #include <vtkIntArray.h>
 #include <vtkMath.h>
 #include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
+#include <vtkSMPTools.h>
+#include <vtkTable.h>
+#include <vtkTimerLog.h>
+#include <vtkWeakPointer.h>
 
 // STD includes
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Kernels = vtkSlicerTrackerStabilizerFilterKernels;
 
+namespace
+{
 //----------------------------------------------------------------------------
-vtkStandardNewMacro(vtkSlicerTrackerStabilizerLogic);
+// Time between two samples
+const double FilterTimeStep = 0.015; // 15ms TODO: get it from timestamp
 
 //----------------------------------------------------------------------------
-vtkSlicerTrackerStabilizerLogic::vtkSlicerTrackerStabilizerLogic()
-{
-}
+// A rate-limited output is due this early, so that ticks arriving slightly
+// before the nominal interval do not halve the update rate
+const double UpdateIntervalTolerance = 0.5*FilterTimeStep;
 
 //----------------------------------------------------------------------------
-vtkSlicerTrackerStabilizerLogic::~vtkSlicerTrackerStabilizerLogic()
-{
-}
+// Largest lag (in samples) searched by the cross-correlation lag metric
+const int MaximumMetricLag = 32;
 
 //----------------------------------------------------------------------------
-void vtkSlicerTrackerStabilizerLogic::PrintSelf(ostream& os, vtkIndent indent)
-{
-  this->Superclass::PrintSelf(os, indent);
-}
+// Number of samples of a sequence filtered between two progress updates
+const size_t SequenceChunkSize = 4096;
 
-//---------------------------------------------------------------------------
-void vtkSlicerTrackerStabilizerLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
-{
-  vtkNew<vtkIntArray> events;
-  events->InsertNextValue(vtkMRMLScene::NodeAddedEvent);
-  events->InsertNextValue(vtkMRMLScene::NodeRemovedEvent);
-  events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
-  this->SetAndObserveMRMLSceneEventsInternal(newScene, events.GetPointer());
-}
+//----------------------------------------------------------------------------
+// Overlap between the chunks of an offline smoothing, in time constants of
+// the filter. The transients at the ends of a chunk decay as exp(-overlap).
+const double SmoothingOverlapTimeConstants = 8.0;
 
-//-----------------------------------------------------------------------------
-void vtkSlicerTrackerStabilizerLogic::RegisterNodes()
-{
-  if( !this->GetMRMLScene() )
-    {
-    vtkWarningMacro( "MRML scene not yet created" );
-    return;
-    }
+//----------------------------------------------------------------------------
+// Largest overlap (in samples) between the chunks of an offline smoothing,
+// reached with very low or zero cutoff frequencies. Bounds the working memory.
+const size_t MaximumSmoothingOverlap = 4*SequenceChunkSize;
 
-  this->GetMRMLScene()->RegisterNodeClass( vtkSmartPointer< vtkMRMLTrackerStabilizerNode >::New() );
-}
+//----------------------------------------------------------------------------
+// Number of diagnostics snapshots kept per node
+const int DiagnosticsCapacity = 600;
 
-//---------------------------------------------------------------------------
-void vtkSlicerTrackerStabilizerLogic::UpdateFromMRMLScene()
+//----------------------------------------------------------------------------
+// Rotation (unit quaternion, w first) and translation
+struct RigidPose
 {
-  assert(this->GetMRMLScene() != 0);
-}
+  double Quaternion[4];
+  double Position[3];
+};
 
-//---------------------------------------------------------------------------
-void vtkSlicerTrackerStabilizerLogic
-::OnMRMLSceneNodeAdded(vtkMRMLNode* node)
+//----------------------------------------------------------------------------
+// Decimated diagnostics snapshots of one node, in a ring written by the main
+// thread when publishing. Readers do not lock: a snapshot is complete once
+// Count (written with release semantics) covers it, and the snapshots the
+// writer may have overwritten meanwhile are discarded after the copy.
+struct DiagnosticsBuffer
 {
-  if ( node == NULL || this->GetMRMLScene() == NULL )
-    {
-    vtkWarningMacro( "OnMRMLSceneNodeAdded: Invalid MRML scene or node" );
-    return;
-    }
+  DiagnosticsBuffer()
+    : Count(0), LastTime(0.0), NumberOfSamples(0), ProcessingTime(0.0)
+  {
+  }
 
-  if ( node->IsA( "vtkMRMLTrackerStabilizerNode" ) )
-    {
-    vtkDebugMacro( "OnMRMLSceneNodeAdded: Module node added." );
-    vtkUnObserveMRMLNodeMacro( node );
-    vtkNew<vtkIntArray> events;
-    events->InsertNextValue( vtkCommand::ModifiedEvent );
-    events->InsertNextValue( vtkMRMLTrackerStabilizerNode::InputDataModifiedEvent );
-    vtkObserveMRMLNodeEventsMacro( node, events.GetPointer() );
-    }
+  double Snapshots[DiagnosticsCapacity][vtkSlicerTrackerStabilizerLogic::Diagnostics_Last];
+  std::atomic<vtkTypeUInt64> Count;
+
+  // Accumulated since the last snapshot, by the main thread only
+  double LastTime;
+  int NumberOfSamples;
+  double ProcessingTime;
+};
+
+//----------------------------------------------------------------------------
+// Slerp tolerance of the fast low-pass filter in parameter sweeps when the
+// logic does not use it
+const double DefaultSweepSlerpTolerance = 1e-6;
 }
 
-//---------------------------------------------------------------------------
-void vtkSlicerTrackerStabilizerLogic
-::OnMRMLSceneNodeRemoved(vtkMRMLNode* node)
+//----------------------------------------------------------------------------
+// Filter state kept between two samples of the same node
+struct vtkSlicerTrackerStabilizerLogic::FilterState
 {
-  if ( node == NULL || this->GetMRMLScene() == NULL )
-    {
-    vtkWarningMacro( "OnMRMLSceneNodeRemoved: Invalid MRML scene or node" );
-    return;
-    }
+  typedef void (*ComputeFunction)(vtkSlicerTrackerStabilizerLogic* logic, FilterState& state);
 
-  if ( node->IsA( "vtkMRMLTrackerStabilizer" ) )
+  // Running sums of the accuracy metrics, so that updating them costs a few
+  // operations per sample and reading them does not go through the history
+  struct MetricSums
+  {
+    MetricSums() { this->Reset(); }
+    void Reset()
     {
-    vtkDebugMacro( "OnMRMLSceneNodeRemoved" );
-    vtkUnObserveMRMLNodeMacro( node );
+      memset(this, 0, sizeof(*this));
     }
-}
 
-//---------------------------------------------------------------------------
-void vtkSlicerTrackerStabilizerLogic
-::ProcessMRMLNodesEvents( vtkObject* caller, unsigned long event, void* /*callData*/)
+    int NumberOfSamples;
+    double PositionError2;  // mm^2
+    double RotationError2;  // deg^2
+
+    // Residual jitter: second difference of the position error, which
+    // removes the slowly varying lag error and keeps the noise
+    double LastJitterPositions[2][3];
+    int NumberOfJitterSamples;
+    double Jitter2;
+
+    // Lag: correlation of the output velocity with the reference velocity
+    // of the previous samples, the lag is at the maximum
+    double LastTime;
+    double LastPosition[3];
+    double LastReferencePosition[3];
+    double ReferenceVelocities[MaximumMetricLag][3];
+    int NumberOfVelocities;
+    int LastVelocity;
+    double Correlations[MaximumMetricLag];
+    int NumberOfTimeSteps;
+    double TimeSteps;
+  };
+
+  FilterState()
+    : Node(NULL)
+    , Configured(false)
+    , Algorithm(Kernels::PassThroughAlgorithm)
+    , TimeStep(FilterTimeStep)
+    , ToolFrame(0.0)
+    , ToolTipTuning(false)
+    , ToolTipLeverArm2(0.0)
+    , TargetToolTipJitter2(0.0)
+    , PositionNoise2(0.0)
+    , RotationNoise2(0.0)
+    , Compute(NULL)
+    , Valid(false)
+    , PublishPending(false)
+    , SampleTime(0.0)
+    , InputNode(NULL)
+    , OutputNode(NULL)
+    , ReferenceNode(NULL)
+    , InputMTime(0)
+    , ReferenceMTime(0)
+    , Converged(false)
+    , ConvergencePositionTolerance2(0.0)
+    , ConvergenceDotTolerance(0.0)
+    , Initialized(false)
+    , StepsSinceNormalization(0)
+    , MotionInitialized(false)
+    , MotionState(vtkMRMLTrackerStabilizerNode::MotionStationary)
+    , LastTime(0.0)
+    , TranslationSpeed(0.0)
+    , RotationSpeed(0.0)
+    , GroundTruthNode(NULL)
+    , ComputeTime(0.0)
+    , Diagnostics(NULL)
+    , GroupID(0)
+    , GroupActive(false)
+    , GroupRejected(false)
+    , Priority(0)
+    , MinimumUpdateInterval(0.0)
+    , NextUpdateTime(0.0)
+    , NumberOfMissedDeadlines(0)
+    , NumberOfShedUpdates(0)
+    , SharedMemoryTool(-1)
+    , NetworkTool(-1)
+  {
+    for (int i = 0; i < 4; i++)
+      {
+      this->CutOffFrequencies[i] = 0.0;
+      this->RestBlendFactors[i] = 1.0;
+      this->StationaryBlendFactors[i] = 1.0;
+      this->BlendFactors[i] = 1.0;
+      this->GroupOffsetBlendFactors[i] = 1.0;
+      }
+  }
+
+  vtkMRMLTrackerStabilizerNode* Node;
+  std::string NodeID;
+
+  // Configuration, updated from the node parameters on the main thread when
+  // the node is modified
+  bool Configured;
+  int Algorithm;
+  double TimeStep;          // s, between two updates of the output
+  // Cutoff frequencies and weights of the input sample when not moving, for
+  // the rotation then the translation axes
+  double CutOffFrequencies[4];
+  double RestBlendFactors[4];
+  double ToolFrame;         // 1 if the translation axes are those of the tool
+
+  // Tool tip jitter target. The input noise is estimated from the
+  // innovations (squared distance and angle between input and filter state)
+  // and the stationary weights are lowered until the expected tip jitter
+  // meets the target.
+  bool ToolTipTuning;
+  double ToolTipLeverArm2;     // mm^2
+  double TargetToolTipJitter2; // mm^2
+  double PositionNoise2;       // mm^2
+  double RotationNoise2;       // rad^2
+  double StationaryBlendFactors[4];
+  Kernels::SlerpCoefficients<double> SlerpCoefficients; // Fast low-pass only
+  ComputeFunction Compute;  // Specialized for the algorithm and options
+
+  // Current sample, gathered from and published to MRML by the main thread.
+  // An output shed at the deadline is written to shared memory and stays
+  // pending, to be published at the next tick unless a new sample
+  // supersedes it.
+  bool Valid;
+  bool PublishPending;
+  double SampleTime;
+  double InputMatrix[4][4];
+  double OutputMatrix[4][4];
+
+  // Nodes the filter state was started with, used only for comparison
+  vtkMRMLLinearTransformNode* InputNode;
+  vtkMRMLLinearTransformNode* OutputNode;
+
+  // Reference, if any. The input matrix and the filter state are then
+  // relative to the reference, and the output is composed with its pose.
+  vtkMRMLLinearTransformNode* ReferenceNode;
+  double ReferenceMatrix[4][4];
+
+  // Dirty tracking: the sample is skipped while the input and reference
+  // have not been modified and the output has reached the input
+  unsigned long InputMTime;
+  unsigned long ReferenceMTime;
+  bool Converged;
+  double ConvergencePositionTolerance2; // mm^2
+  double ConvergenceDotTolerance;       // 1 - cos(tolerance/2)
+
+  // Filtered pose, kept between samples instead of being read back from the
+  // output node. The quaternion stays in the same hemisphere from one sample
+  // to the next.
+  bool Initialized;
+  double Quaternion[4];
+  double Position[3];
+  unsigned int StepsSinceNormalization;
+
+  // Motion detection
+  bool MotionInitialized;
+  int MotionState;
+  double LastTime;
+  double LastPosition[3];
+  double LastQuaternion[4];
+  double TranslationSpeed; // mm/s
+  double RotationSpeed;    // deg/s
+  double BlendFactors[4];  // Weights of the input sample
+
+  // Accuracy of the output against the ground truth node, if any
+  vtkMRMLLinearTransformNode* GroundTruthNode;
+  MetricSums Metrics;
+
+  // Diagnostics, when enabled: duration of the last computation (s) and
+  // snapshot buffer, owned by the logic
+  double ComputeTime;
+  DiagnosticsBuffer* Diagnostics;
+
+  // Group of filters moving together, 0 if none. When active for the
+  // sample, the filter steps the offset of the input from the mean input
+  // pose of the group, with its own weights, and the filter state is the
+  // filtered offset composed with the filtered common motion. The poses of
+  // the group are set by the main thread: inverse of the mean input and of
+  // the common motion before the step, and common motion after the step.
+  // A filter whose reference node differs from the first member's is
+  // rejected from the group and filtered on its own.
+  int GroupID;
+  double GroupOffsetBlendFactors[4];
+  bool GroupActive;
+  bool GroupRejected;
+  RigidPose GroupInputInverse;
+  RigidPose GroupPreviousInverse;
+  RigidPose GroupFiltered;
+
+  // Scheduling: priority and rate limit from the node parameters, and
+  // updates published after the deadline or postponed past it (shed)
+  int Priority;
+  double MinimumUpdateInterval; // s, 0 if the update rate is not limited
+  double NextUpdateTime;
+  vtkTypeInt64 NumberOfMissedDeadlines;
+  vtkTypeInt64 NumberOfShedUpdates;
+
+  // Slot in the shared memory and network outputs, -1 if not assigned yet
+  int SharedMemoryTool;
+  int NetworkTool;
+  std::string NetworkToolName; // Name the network tool was added with
+};
+
+//----------------------------------------------------------------------------
+class vtkSlicerTrackerStabilizerLogic::vtkInternal
 {
-  vtkMRMLNode* callerNode = vtkMRMLNode::SafeDownCast( caller );
-  if ( callerNode == NULL )
-    {
-    return;
-    }
+public:
+  vtkInternal()
+    : ScheduleModified(true)
+    , NetworkLastSendTime(0.0)
+  {
+    this->TransferMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    this->SequenceThreader = vtkSmartPointer<vtkMultiThreader>::New();
+  }
 
-  vtkMRMLTrackerStabilizerNode* tsNode = vtkMRMLTrackerStabilizerNode::SafeDownCast( callerNode );
-  if ( tsNode == NULL )
+  typedef std::vector<FilterState> FilterStateVector;
+
+  // Computes a range of filter states, possibly from a worker thread
+  class ComputeFunctor
+  {
+  public:
+    ComputeFunctor(vtkSlicerTrackerStabilizerLogic* logic, FilterState* states)
+      : Logic(logic), States(states) {}
+    void operator()(vtkIdType begin, vtkIdType end)
     {
-    return;
+      for (vtkIdType i = begin; i < end; ++i)
+        {
+        this->Logic->ComputeFilter(this->States[i]);
+        }
     }
+    vtkSlicerTrackerStabilizerLogic* Logic;
+    FilterState* States;
+  };
 
-  if ( event == vtkMRMLTrackerStabilizerNode::InputDataModifiedEvent )
+  // Computes a range of the single precision batch, possibly from a worker thread
+  class BatchFunctor
+  {
+  public:
+    BatchFunctor(vtkInternal* internal) : Internal(internal) {}
+    void operator()(vtkIdType begin, vtkIdType end)
     {
+      const size_t stride = this->Internal->BatchStates.size();
+      Kernels::FilterBatch<float, Kernels::LowPassFilter>(
+        static_cast<size_t>(begin), static_cast<size_t>(end), stride,
+        &this->Internal->BatchAlpha[0], &this->Internal->BatchToolFrame[0],
+        &this->Internal->BatchInputQuaternions[0], &this->Internal->BatchInputPositions[0],
+        &this->Internal->BatchQuaternions[0], &this->Internal->BatchPositions[0]);
     }
-}
-
-//----------------------------------------------------------------------------
-// Spherical linear interpolation between two rotation quaternions.
-// t is a value between 0 and 1 that interpolates between from and to (t=0 means the results is the same as "from").
-// Precondition: no aliasing problems to worry about ("result" can be "from" or "to" param).
-// Parameters: adjustSign - If true, then slerp will operate by adjusting the sign of the slerp to take shortest path. True is recommended, otherwise the interpolation sometimes give unexpected results. 
-// References: From Adv Anim and Rendering Tech. Pg 364
-
-void vtkSlicerTrackerStabilizerLogic
-::Slerp(double *result, double t, double *from, double *to, bool adjustSign)
-{
-  const double* p = from; // just an alias to match q
+    vtkInternal* Internal;
+  };
 
-  // calc cosine theta
-  double cosom = from[0]*to[0]+from[1]*to[1]+from[2]*to[2]+from[3]*to[3]; // dot( from, to )
+  // Pose of a reference node, read once per tick and shared by all the
+  // filters that use it
+  struct ReferencePose
+  {
+    vtkMRMLLinearTransformNode* Node;
+    double Matrix[4][4];
+    double Inverse[4][4];
+  };
+  std::vector<ReferencePose> ReferencePoses;
 
-  // adjust signs (if necessary)
-  double q[4];
-  if (adjustSign && (cosom < (double)0.0))
+  const ReferencePose& GetReferencePose(vtkMRMLLinearTransformNode* node)
   {
-    cosom = -cosom;
-    q[0] = -to[0];   // Reverse all signs
-    q[1] = -to[1];
-    q[2] = -to[2];
-    q[3] = -to[3];
+    for (size_t i = 0; i < this->ReferencePoses.size(); ++i)
+      {
+      if (this->ReferencePoses[i].Node == node)
+        {
+        return this->ReferencePoses[i];
+        }
+      }
+    ReferencePose reference;
+    reference.Node = node;
+    node->GetMatrixTransformToParent(this->TransferMatrix);
+    memcpy(reference.Matrix, this->TransferMatrix->Element, sizeof(reference.Matrix));
+    vtkMatrix4x4::Invert(&reference.Matrix[0][0], &reference.Inverse[0][0]);
+    this->ReferencePoses.push_back(reference);
+    return this->ReferencePoses.back();
   }
-  else
+
+  // Go back from the reference frame to the parent frame
+  static void ComposeReference(FilterState& state)
   {
-    q[0] = to[0];
-    q[1] = to[1];
-    q[2] = to[2];
-    q[3] = to[3];
+    if (state.ReferenceNode == NULL)
+      {
+      return;
+      }
+    double relative[16];
+    memcpy(relative, state.OutputMatrix, sizeof(relative));
+    vtkMatrix4x4::Multiply4x4(&state.ReferenceMatrix[0][0], relative, &state.OutputMatrix[0][0]);
   }
 
-  // Calculate coefficients
-  double sclp, sclq;
-  if (((double)1.0 - cosom) > (double)0.0001) // 0.0001 -> some epsillon
+  // Lower the stationary weights so that the tip jitter meets the target.
+  // For white noise, a first-order low-pass filter with weight a scales the
+  // variance by a/(2-a); rotation noise reaches the tip through the lever
+  // arm, so both are smoothed by the same factor.
+  static void UpdateToolTipTuning(FilterState& state,
+                                  const double inputQuaternion[4], const double inputPosition[3])
   {
-    // Standard case (slerp)
-    double omega, sinom;
-    omega = acos( cosom ); // extract theta from dot product's cos theta
-    sinom = sin( omega );
-    sclp  = sin( ((double)1.0 - t) * omega ) / sinom;
-    sclq  = sin( t * omega ) / sinom;
+    const double noiseWeight = state.TimeStep / (1.0 + state.TimeStep); // ~1s
+    const double positionInnovation2 =
+      vtkMath::Distance2BetweenPoints(inputPosition, state.Position);
+    const double cosHalfAngle = std::min(1.0, fabs(
+      inputQuaternion[0]*state.Quaternion[0] + inputQuaternion[1]*state.Quaternion[1] +
+      inputQuaternion[2]*state.Quaternion[2] + inputQuaternion[3]*state.Quaternion[3]));
+    const double angle = 2.0*acos(cosHalfAngle);
+    state.PositionNoise2 += noiseWeight*(positionInnovation2 - state.PositionNoise2);
+    state.RotationNoise2 += noiseWeight*(angle*angle - state.RotationNoise2);
+    UpdateStationaryBlendFactors(state);
   }
-  else
+
+  // Stationary weights from the rest weights and, when tuning, from the
+  // current noise estimate. The estimate describes the input, not the
+  // parameters, so it is kept when the filter is configured again.
+  static void UpdateStationaryBlendFactors(FilterState& state)
   {
-    // Very close, do linear interp (because it's faster)
-    sclp = (double)1.0 - t;
-    sclq = t;
+    const double tipNoise2 = state.PositionNoise2 + state.ToolTipLeverArm2*state.RotationNoise2;
+    double tipBlendFactor = 1.0;
+    if (state.ToolTipTuning && tipNoise2 > state.TargetToolTipJitter2)
+      {
+      const double ratio = state.TargetToolTipJitter2 / tipNoise2;
+      tipBlendFactor = 2.0*ratio / (1.0 + ratio);
+      }
+    for (int i = 0; i < 4; i++)
+      {
+      state.StationaryBlendFactors[i] = std::min(state.RestBlendFactors[i], tipBlendFactor);
+      }
   }
 
-  for (int i=0; i<4; i++)
+  // Whether the filter state is within the convergence tolerances of the
+  // input, in which case it is snapped to the input
+  static void UpdateConverged(FilterState& state,
+                              const double inputQuaternion[4], const double inputPosition[3])
   {
-    result[i] = sclp * p[i] + sclq * q[i];
+    state.Converged = Kernels::SnapToInput(inputQuaternion, inputPosition,
+                                           state.ConvergencePositionTolerance2,
+                                           state.ConvergenceDotTolerance,
+                                           state.Quaternion, state.Position);
   }
-}
 
-//----------------------------------------------------------------------------
-// Interpolate the matrix for the given timestamp from the two nearest
-// transforms in the buffer.
-// The rotation is interpolated with SLERP interpolation, and the
-// position is interpolated with linear interpolation.
-// The flags correspond to the closest element.
+  // Filter computation, specialized when the filter is configured
+  template <class Algorithm, bool MotionDetection>
+  static void Compute(vtkSlicerTrackerStabilizerLogic* logic, FilterState& state);
 
-void vtkSlicerTrackerStabilizerLogic
-::GetInterpolatedTransform(vtkMatrix4x4* itemAmatrix, vtkMatrix4x4* itemBmatrix, 
-			   double itemAweight, double itemBweight,
-			   vtkMatrix4x4* interpolatedMatrix)
-{
-  double itemAweightNormalized=itemAweight/(itemAweight+itemBweight);
-  double itemBweightNormalized=itemBweight/(itemAweight+itemBweight);
+  // Filter nodes with both an input and an output, sorted by node ID so that
+  // lookups from node events are logarithmic and the processing order is
+  // deterministic. Maintained incrementally from scene and node events, so
+  // that per-tick processing does not depend on the size of the scene.
+  FilterStateVector ActiveFilters;
 
-  double matrixA[3][3]={{0,0,0},{0,0,0},{0,0,0}};
-  for (int i = 0; i < 3; i++)
+  FilterStateVector::iterator LowerBound(const char* nodeID);
+  FilterState* Find(vtkMRMLTrackerStabilizerNode* tsNode);
+
+  // Common motion of each group of filters, by group ID. A group is
+  // forgotten when it has no initialized member anymore.
+  struct GroupState
+  {
+    GroupState()
+      : Initialized(false), Converged(false), NumberOfMembers(0), NumberOfSamples(0), Leader(NULL)
+    {
+    }
+
+    bool Initialized;
+    bool Converged;
+    RigidPose Filtered;
+    Kernels::SlerpCoefficients<double> SlerpCoefficients;
+    // Inverse of the mean input and of the common motion before the step
+    RigidPose InputInverse;
+    RigidPose PreviousInverse;
+
+    // Mean input pose, accumulated for each tick
+    int NumberOfMembers;
+    int NumberOfSamples;
+    double QuaternionSum[4];
+    double PositionSum[3];
+    const FilterState* Leader; // First member by node ID, gives the cutoffs
+  };
+  typedef std::map<int, GroupState> GroupStateMap;
+  GroupStateMap Groups;
+
+  // Indices of the active filters by decreasing priority, then node ID.
+  // Rebuilt before a tick when the active set or a priority has changed.
+  std::vector<size_t> Schedule;
+  bool ScheduleModified;
+
+  void UpdateSchedule();
+
+  // Matrix used to transfer transforms from and to MRML
+  vtkSmartPointer<vtkMatrix4x4> TransferMatrix;
+
+  // Single precision batch of low-pass filters, structure of arrays
+  std::vector<FilterState*> BatchStates;
+  std::vector<float> BatchAlpha;
+  std::vector<float> BatchToolFrame;
+  std::vector<float> BatchInputQuaternions;
+  std::vector<float> BatchInputPositions;
+  std::vector<float> BatchQuaternions;
+  std::vector<float> BatchPositions;
+
+  TrackerStabilizerSharedMemoryWriter SharedMemoryWriter;
+
+  TrackerStabilizerNetworkSender NetworkSender;
+  double NetworkLastSendTime;
+
+  // Sequence filtered by a worker thread. The main thread reads the input
+  // sequence into the arrays, the worker filters them in place by chunks and
+  // the main thread writes the output sequence once the worker is done.
+  // Progress, Cancel and Done are shared with the worker.
+  struct SequenceJob
+  {
+    SequenceJob()
+      : ThreadID(-1), Algorithm(Kernels::LowPassAlgorithm), ToolFrame(0.0), NumberOfSlerpTerms(0),
+        Progress(0), Cancel(0), Done(0)
+    {
+      for (int i = 0; i < 4; ++i)
+        {
+        this->CutOffFrequencies[i] = 0.0;
+        }
+    }
+
+    int ThreadID; // -1 when there is no job
+    int Algorithm;
+    double CutOffFrequencies[4];
+    double ToolFrame;
+    int NumberOfSlerpTerms;
+    std::vector<double> Times;
+    std::vector<double> Quaternions;
+    std::vector<double> Positions;
+    std::vector<std::string> IndexValues;
+    vtkWeakPointer<vtkMRMLNode> InputSequenceNode;
+    vtkWeakPointer<vtkMRMLNode> OutputSequenceNode;
+    std::atomic<size_t> Progress; // Number of samples filtered
+    std::atomic<int> Cancel;
+    std::atomic<int> Done;
+  };
+  SequenceJob Sequence;
+  vtkSmartPointer<vtkMultiThreader> SequenceThreader;
+
+  // Diagnostics snapshots by node ID, kept until the node leaves the scene
+  typedef std::map<std::string, DiagnosticsBuffer*> DiagnosticsBufferMap;
+  DiagnosticsBufferMap DiagnosticsBuffers;
+
+  DiagnosticsBuffer* GetDiagnosticsBuffer(FilterState& state)
   {
-    matrixA[i][0] = itemAmatrix->GetElement(i,0);
-    matrixA[i][1] = itemAmatrix->GetElement(i,1);
-    matrixA[i][2] = itemAmatrix->GetElement(i,2);
+    if (state.Diagnostics == NULL)
+      {
+      DiagnosticsBuffer*& buffer = this->DiagnosticsBuffers[state.NodeID];
+      if (buffer == NULL)
+        {
+        buffer = new DiagnosticsBuffer;
+        }
+      state.Diagnostics = buffer;
+      }
+    return state.Diagnostics;
   }
 
-  double matrixB[3][3] = {{0,0,0}, {0,0,0}, {0,0,0}};
-  for (int i = 0; i < 3; i++)
+  void RemoveDiagnosticsBuffer(const std::string& nodeID)
   {
-    matrixB[i][0] = itemBmatrix->GetElement(i,0);
-    matrixB[i][1] = itemBmatrix->GetElement(i,1);
-    matrixB[i][2] = itemBmatrix->GetElement(i,2);
+    DiagnosticsBufferMap::iterator it = this->DiagnosticsBuffers.find(nodeID);
+    if (it != this->DiagnosticsBuffers.end())
+      {
+      delete it->second;
+      this->DiagnosticsBuffers.erase(it);
+      }
   }
 
-  double matrixAquat[4]= {0,0,0,0};
-  vtkMath::Matrix3x3ToQuaternion(matrixA, matrixAquat);
-  double matrixBquat[4]= {0,0,0,0};
-  vtkMath::Matrix3x3ToQuaternion(matrixB, matrixBquat);
-  double interpolatedRotationQuat[4]= {0,0,0,0};
-  Slerp(interpolatedRotationQuat, itemBweightNormalized, matrixAquat, matrixBquat);
-  double interpolatedRotation[3][3] = {{0,0,0},{0,0,0},{0,0,0}};
-  vtkMath::QuaternionToMatrix3x3(interpolatedRotationQuat, interpolatedRotation);
+  static VTK_THREAD_RETURN_TYPE FilterSequenceThread(void* arg);
+  template <class Algorithm>
+  static void FilterSequenceJob(SequenceJob& job);
+};
 
-  for (int i = 0; i < 3; i++)
+namespace
+{
+//----------------------------------------------------------------------------
+bool FilterStateIDLess(const vtkSlicerTrackerStabilizerLogic::FilterState& state, const char* nodeID)
+{
+  return strcmp(state.NodeID.c_str(), nodeID) < 0;
+}
+
+//----------------------------------------------------------------------------
+bool FilterStateLess(const vtkSlicerTrackerStabilizerLogic::FilterState& a,
+                     const vtkSlicerTrackerStabilizerLogic::FilterState& b)
+{
+  return a.NodeID < b.NodeID;
+}
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerTrackerStabilizerLogic::vtkInternal::FilterStateVector::iterator
+vtkSlicerTrackerStabilizerLogic::vtkInternal::LowerBound(const char* nodeID)
+{
+  return std::lower_bound(this->ActiveFilters.begin(), this->ActiveFilters.end(),
+                          nodeID, FilterStateIDLess);
+}
+
+//----------------------------------------------------------------------------
+struct SchedulePriorityGreater
+{
+  SchedulePriorityGreater(const vtkSlicerTrackerStabilizerLogic::FilterState* states)
+    : States(states) {}
+  bool operator()(size_t a, size_t b) const
   {
-    interpolatedMatrix->Element[i][0] = interpolatedRotation[i][0];
-    interpolatedMatrix->Element[i][1] = interpolatedRotation[i][1];
-    interpolatedMatrix->Element[i][2] = interpolatedRotation[i][2];
-    interpolatedMatrix->Element[i][3] = itemAmatrix->GetElement(i,3)*itemAweightNormalized + 
-      itemBmatrix->GetElement(i,3)*itemBweightNormalized;
+    // Filters are sorted by node ID, so are their indices
+    return (this->States[a].Priority != this->States[b].Priority) ?
+      this->States[a].Priority > this->States[b].Priority : a < b;
   }
-}
+  const vtkSlicerTrackerStabilizerLogic::FilterState* States;
+};
 
-//-----------------------------------------------------------------------------
-void vtkSlicerTrackerStabilizerLogic
-::Filter(vtkMRMLTrackerStabilizerNode* tsNode)
+//----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic::vtkInternal::UpdateSchedule()
 {
-  if ( tsNode == NULL )
+  this->Schedule.resize(this->ActiveFilters.size());
+  for (size_t i = 0; i < this->Schedule.size(); ++i)
     {
-    return;
+    this->Schedule[i] = i;
     }
-
-  vtkMRMLLinearTransformNode* inputNode = tsNode->GetInputTransformNode();
-  vtkMRMLLinearTransformNode* outputNode = tsNode->GetFilteredTransformNode();
-
-  if ( inputNode == NULL || outputNode == NULL)
+  if (!this->ActiveFilters.empty())
     {
-    return;
+    std::sort(this->Schedule.begin(), this->Schedule.end(),
+              SchedulePriorityGreater(&this->ActiveFilters[0]));
     }
+  this->ScheduleModified = false;
+}
 
-  // Compute weights (low-pass filter with w_cutoff frequency)
-  const double dt = 0.015; // 15ms TODO: get it from timestamp
-  const double cutoff_frequency = tsNode->GetCutOffFrequency();
-  const double weightPrevious = 1;
-  const double weightCurrent = dt*cutoff_frequency;
-
-  // Get matrices
-  vtkSmartPointer<vtkMatrix4x4> matrixCurrent = vtkSmartPointer<vtkMatrix4x4>::New();
-  inputNode->GetMatrixTransformToParent(matrixCurrent);
+//----------------------------------------------------------------------------
+vtkSlicerTrackerStabilizerLogic::FilterState*
+vtkSlicerTrackerStabilizerLogic::vtkInternal::Find(vtkMRMLTrackerStabilizerNode* tsNode)
+{
+  if (tsNode == NULL || tsNode->GetID() == NULL)
+    {
+    return NULL;
+    }
+  FilterStateVector::iterator it = this->LowerBound(tsNode->GetID());
+  if (it == this->ActiveFilters.end() || it->Node != tsNode)
+    {
+    return NULL;
+    }
+  return &(*it);
+}
 
-  vtkSmartPointer<vtkMatrix4x4> matrixPrevious = vtkSmartPointer<vtkMatrix4x4>::New();
-  outputNode->GetMatrixTransformToParent(matrixPrevious);
+namespace
+{
+//----------------------------------------------------------------------------
+// Motion state reached by a speed. Going up is immediate, going down requires
+// the speed to drop below (1 - hysteresis) times the threshold of the state.
+int ClassifySpeed(int currentState, double speed,
+                  double slowSpeed, double fastSpeed, double hysteresis)
+{
+  int state = vtkMRMLTrackerStabilizerNode::MotionStationary;
+  if (speed >= fastSpeed)
+    {
+    state = vtkMRMLTrackerStabilizerNode::MotionFast;
+    }
+  else if (speed >= slowSpeed)
+    {
+    state = vtkMRMLTrackerStabilizerNode::MotionSlow;
+    }
+  if (state >= currentState)
+    {
+    return state;
+    }
 
-  vtkSmartPointer<vtkMatrix4x4> matrixOutput = vtkSmartPointer<vtkMatrix4x4>::New();
-  if (tsNode->GetFilterActivated() == false)
+  const double release = 1.0 - hysteresis;
+  if (currentState == vtkMRMLTrackerStabilizerNode::MotionFast && speed >= fastSpeed*release)
     {
-    // No filter. Output Transform = Input Transform
-    inputNode->GetMatrixTransformToParent(matrixOutput);
+    return vtkMRMLTrackerStabilizerNode::MotionFast;
     }
-  else
+  if (speed >= slowSpeed*release)
     {
-    // Compute interpolated matrix
-    GetInterpolatedTransform(matrixPrevious, matrixCurrent, weightPrevious, weightCurrent, matrixOutput);
+    return vtkMRMLTrackerStabilizerNode::MotionSlow;
     }
+  return vtkMRMLTrackerStabilizerNode::MotionStationary;
+}
 
-  // Setting the TransformNode
-  outputNode->SetMatrixTransformToParent(matrixOutput);
+//----------------------------------------------------------------------------
+void NormalizeQuaternion(double quaternion[4])
+{
+  const double norm = sqrt(quaternion[0]*quaternion[0] + quaternion[1]*quaternion[1] +
+                           quaternion[2]*quaternion[2] + quaternion[3]*quaternion[3]);
+  for (int i = 0; i < 4; ++i)
+    {
+    quaternion[i] /= norm;
+    }
+}
+
+//----------------------------------------------------------------------------
+void MatrixToPose(const double matrix[4][4], double quaternion[4], double position[3])
+{
+  double rotation[3][3];
+  for (int i = 0; i < 3; i++)
+    {
+    rotation[i][0] = matrix[i][0];
+    rotation[i][1] = matrix[i][1];
+    rotation[i][2] = matrix[i][2];
+    position[i] = matrix[i][3];
+    }
+  vtkMath::Matrix3x3ToQuaternion(rotation, quaternion);
 }
+
+//----------------------------------------------------------------------------
+void PoseToMatrix(const double quaternion[4], const double position[3], double matrix[4][4])
+{
+  double rotation[3][3];
+  vtkMath::QuaternionToMatrix3x3(quaternion, rotation);
+  for (int i = 0; i < 3; i++)
+    {
+    matrix[i][0] = rotation[i][0];
+    matrix[i][1] = rotation[i][1];
+    matrix[i][2] = rotation[i][2];
+    matrix[i][3] = position[i];
+    }
+  matrix[3][0] = 0.0;
+  matrix[3][1] = 0.0;
+  matrix[3][2] = 0.0;
+  matrix[3][3] = 1.0;
+}
+
+//----------------------------------------------------------------------------
+// Rotate a vector by a unit quaternion
+void RotateVector(const double quaternion[4], const double vector[3], double rotated[3])
+{
+  // v + 2w (u x v) + 2u x (u x v), u being the vector part
+  const double* u = quaternion + 1;
+  double t[3];
+  vtkMath::Cross(u, vector, t);
+  for (int i = 0; i < 3; ++i)
+    {
+    t[i] *= 2.0;
+    }
+  double ut[3];
+  vtkMath::Cross(u, t, ut);
+  for (int i = 0; i < 3; ++i)
+    {
+    rotated[i] = vector[i] + quaternion[0]*t[i] + ut[i];
+    }
+}
+
+//----------------------------------------------------------------------------
+// Pose a*b, b given as a quaternion and a position
+void ComposePoses(const RigidPose& a, const double quaternion[4], const double position[3],
+                  double composedQuaternion[4], double composedPosition[3])
+{
+  RotateVector(a.Quaternion, position, composedPosition);
+  for (int i = 0; i < 3; ++i)
+    {
+    composedPosition[i] += a.Position[i];
+    }
+  vtkMath::MultiplyQuaternion(a.Quaternion, quaternion, composedQuaternion);
+}
+
+//----------------------------------------------------------------------------
+void InvertPose(const double quaternion[4], const double position[3], RigidPose& inverse)
+{
+  inverse.Quaternion[0] = quaternion[0];
+  inverse.Quaternion[1] = -quaternion[1];
+  inverse.Quaternion[2] = -quaternion[2];
+  inverse.Quaternion[3] = -quaternion[3];
+  RotateVector(inverse.Quaternion, position, inverse.Position);
+  for (int i = 0; i < 3; ++i)
+    {
+    inverse.Position[i] = -inverse.Position[i];
+    }
+}
+
+//----------------------------------------------------------------------------
+// Add a sample to the accuracy metrics. The residual jitter is that of the
+// error to the reference when relativeJitter is true, that of the output
+// otherwise (when the reference is the noisy input).
+void AccumulateMetrics(vtkSlicerTrackerStabilizerLogic::FilterState::MetricSums& metrics, double time,
+                       const double quaternion[4], const double position[3],
+                       const double referenceQuaternion[4], const double referencePosition[3],
+                       bool relativeJitter)
+{
+  double positionError[3];
+  double jitterPosition[3];
+  for (int i = 0; i < 3; i++)
+    {
+    positionError[i] = position[i] - referencePosition[i];
+    jitterPosition[i] = relativeJitter ? positionError[i] : position[i];
+    }
+  const double cosHalfAngle = std::min(1.0, fabs(
+    quaternion[0]*referenceQuaternion[0] + quaternion[1]*referenceQuaternion[1] +
+    quaternion[2]*referenceQuaternion[2] + quaternion[3]*referenceQuaternion[3]));
+  const double angle = vtkMath::DegreesFromRadians(2.0*acos(cosHalfAngle));
+  metrics.PositionError2 += vtkMath::Dot(positionError, positionError);
+  metrics.RotationError2 += angle*angle;
+
+  if (metrics.NumberOfSamples >= 2)
+    {
+    double secondDifference[3];
+    for (int i = 0; i < 3; i++)
+      {
+      secondDifference[i] = jitterPosition[i] -
+        2.0*metrics.LastJitterPositions[0][i] + metrics.LastJitterPositions[1][i];
+      }
+    metrics.Jitter2 += vtkMath::Dot(secondDifference, secondDifference);
+    metrics.NumberOfJitterSamples++;
+    }
+
+  const double dt = time - metrics.LastTime;
+  if (metrics.NumberOfSamples >= 1 && dt > 0.0)
+    {
+    double velocity[3];
+    metrics.LastVelocity = (metrics.LastVelocity + 1) % MaximumMetricLag;
+    double* referenceVelocity = metrics.ReferenceVelocities[metrics.LastVelocity];
+    for (int i = 0; i < 3; i++)
+      {
+      velocity[i] = (position[i] - metrics.LastPosition[i]) / dt;
+      referenceVelocity[i] = (referencePosition[i] - metrics.LastReferencePosition[i]) / dt;
+      }
+    metrics.NumberOfVelocities = std::min(metrics.NumberOfVelocities + 1, MaximumMetricLag);
+    for (int lag = 0; lag < metrics.NumberOfVelocities; ++lag)
+      {
+      const int index = (metrics.LastVelocity - lag + MaximumMetricLag) % MaximumMetricLag;
+      metrics.Correlations[lag] += vtkMath::Dot(velocity, metrics.ReferenceVelocities[index]);
+      }
+    metrics.TimeSteps += dt;
+    metrics.NumberOfTimeSteps++;
+    }
+
+  for (int i = 0; i < 3; i++)
+    {
+    metrics.LastJitterPositions[1][i] = metrics.LastJitterPositions[0][i];
+    metrics.LastJitterPositions[0][i] = jitterPosition[i];
+    metrics.LastPosition[i] = position[i];
+    metrics.LastReferencePosition[i] = referencePosition[i];
+    }
+  metrics.LastTime = time;
+  metrics.NumberOfSamples++;
+}
+
+//----------------------------------------------------------------------------
+// Value of one of vtkSlicerTrackerStabilizerLogic::FilterMetrics, 0 without samples
+double ComputeMetric(const vtkSlicerTrackerStabilizerLogic::FilterState::MetricSums& metrics, int metric)
+{
+  if (metrics.NumberOfSamples == 0)
+    {
+    return 0.0;
+    }
+  switch (metric)
+    {
+    case vtkSlicerTrackerStabilizerLogic::MetricNumberOfSamples:
+      return metrics.NumberOfSamples;
+    case vtkSlicerTrackerStabilizerLogic::MetricPositionRMSError:
+      return sqrt(metrics.PositionError2 / metrics.NumberOfSamples);
+    case vtkSlicerTrackerStabilizerLogic::MetricRotationRMSError:
+      return sqrt(metrics.RotationError2 / metrics.NumberOfSamples);
+    case vtkSlicerTrackerStabilizerLogic::MetricResidualJitter:
+      // The second difference of white noise has 6 times its variance
+      return metrics.NumberOfJitterSamples > 0 ?
+        sqrt(metrics.Jitter2 / (6.0*metrics.NumberOfJitterSamples)) : 0.0;
+    case vtkSlicerTrackerStabilizerLogic::MetricLag:
+      {
+      if (metrics.NumberOfTimeSteps == 0)
+        {
+        return 0.0;
+        }
+      int best = 0;
+      for (int lag = 1; lag < metrics.NumberOfVelocities; ++lag)
+        {
+        if (metrics.Correlations[lag] > metrics.Correlations[best])
+          {
+          best = lag;
+          }
+        }
+      // Parabolic interpolation between the samples around the maximum
+      double lag = best;
+      if (best > 0 && best < metrics.NumberOfVelocities - 1)
+        {
+        const double previous = metrics.Correlations[best - 1];
+        const double current = metrics.Correlations[best];
+        const double next = metrics.Correlations[best + 1];
+        const double curvature = previous - 2.0*current + next;
+        if (curvature < 0.0)
+          {
+          lag += 0.5*(previous - next) / curvature;
+          }
+        }
+      return lag * metrics.TimeSteps / metrics.NumberOfTimeSteps;
+      }
+    default:
+      return 0.0;
+    }
+}
+
+//----------------------------------------------------------------------------
+bool HasTuples(vtkDataArray* array, int numberOfComponents, vtkIdType numberOfTuples)
+{
+  return array != NULL && array->GetNumberOfComponents() == numberOfComponents &&
+    array->GetNumberOfTuples() == numberOfTuples;
+}
+
+//----------------------------------------------------------------------------
+// Filter a pose sequence stored as arrays of structures
+template <class Algorithm>
+void FilterPoseArrays(const double cutOffFrequencies[4], double toolFrame, int numberOfSlerpTerms,
+                      size_t numberOfSamples, const double* times,
+                      const double* inputQuaternions, const double* inputPositions,
+                      double* quaternions, double* positions)
+{
+  Kernels::SequenceFilter<double, Algorithm> filter;
+  filter.Configure(cutOffFrequencies, toolFrame, numberOfSlerpTerms, FilterTimeStep);
+  Kernels::FilterSequence(filter, numberOfSamples, times,
+                          inputQuaternions, inputPositions, quaternions, positions);
+}
+
+//----------------------------------------------------------------------------
+// Recorded pose stream, normalized once and shared by all the combinations
+// of a parameter sweep
+struct SweepInput
+{
+  size_t NumberOfSamples;
+  std::vector<double> Times;
+  std::vector<double> Quaternions;
+  std::vector<double> Positions;
+  // Ground truth, or the input itself
+  const double* ReferenceQuaternions;
+  const double* ReferencePositions;
+  bool HasGroundTruth;
+  int NumberOfSlerpTerms;
+};
+
+//----------------------------------------------------------------------------
+template <class Algorithm>
+void SweepCombination(const SweepInput& input, double cutOffFrequency,
+                      vtkSlicerTrackerStabilizerLogic::FilterState::MetricSums& metrics)
+{
+  const double cutOffFrequencies[4] =
+    { cutOffFrequency, cutOffFrequency, cutOffFrequency, cutOffFrequency };
+  Kernels::SequenceFilter<double, Algorithm> filter;
+  filter.Configure(cutOffFrequencies, 0.0, input.NumberOfSlerpTerms, FilterTimeStep);
+  for (size_t i = 0; i < input.NumberOfSamples; ++i)
+    {
+    filter.Step(input.Times[i], &input.Quaternions[4*i], &input.Positions[3*i]);
+    AccumulateMetrics(metrics, input.Times[i], filter.Quaternion, filter.Position,
+                      input.ReferenceQuaternions + 4*i, input.ReferencePositions + 3*i,
+                      input.HasGroundTruth);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Filters a range of the combinations of a sweep, possibly from a worker thread
+class SweepFunctor
+{
+public:
+  SweepFunctor(const SweepInput& input, const std::vector<int>& algorithms,
+               const std::vector<double>& cutOffFrequencies,
+               std::vector<vtkSlicerTrackerStabilizerLogic::FilterState::MetricSums>& metrics)
+    : Input(input), Algorithms(algorithms), CutOffFrequencies(cutOffFrequencies), Metrics(metrics) {}
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    for (vtkIdType i = begin; i < end; ++i)
+      {
+      switch (this->Algorithms[i])
+        {
+        case Kernels::PassThroughAlgorithm:
+          SweepCombination<Kernels::PassThroughFilter>(this->Input, this->CutOffFrequencies[i], this->Metrics[i]);
+          break;
+        case Kernels::FastLowPassAlgorithm:
+          SweepCombination<Kernels::FastLowPassFilter>(this->Input, this->CutOffFrequencies[i], this->Metrics[i]);
+          break;
+        default:
+          SweepCombination<Kernels::LowPassFilter>(this->Input, this->CutOffFrequencies[i], this->Metrics[i]);
+          break;
+        }
+      }
+  }
+  const SweepInput& Input;
+  const std::vector<int>& Algorithms;
+  const std::vector<double>& CutOffFrequencies;
+  std::vector<vtkSlicerTrackerStabilizerLogic::FilterState::MetricSums>& Metrics;
+};
+}
+
+//----------------------------------------------------------------------------
+template <class Algorithm, bool MotionDetection>
+void vtkSlicerTrackerStabilizerLogic::vtkInternal
+::Compute(vtkSlicerTrackerStabilizerLogic* logic, FilterState& state)
+{
+  double inputQuaternion[4];
+  double inputPosition[3];
+  MatrixToPose(state.InputMatrix, inputQuaternion, inputPosition);
+  double* quaternion = state.Quaternion;
+  double* position = state.Position;
+
+  if (state.ToolTipTuning)
+    {
+    vtkInternal::UpdateToolTipTuning(state, inputQuaternion, inputPosition);
+    }
+  const double* alpha = state.StationaryBlendFactors;
+  if (MotionDetection)
+    {
+    // Relax the filter while the tool is moving
+    logic->UpdateMotionState(state.Node, state, state.TimeStep);
+    alpha = state.BlendFactors;
+    }
+  else
+    {
+    state.MotionInitialized = false;
+    }
+
+  // Slerp follows the shortest path from the filtered quaternion, which
+  // keeps it in the same hemisphere
+  if (state.GroupActive)
+    {
+    // Step the offset from the common motion, then move it with the group
+    double inputOffsetQuaternion[4];
+    double inputOffsetPosition[3];
+    double offsetQuaternion[4];
+    double offsetPosition[3];
+    ComposePoses(state.GroupInputInverse, inputQuaternion, inputPosition,
+                 inputOffsetQuaternion, inputOffsetPosition);
+    ComposePoses(state.GroupPreviousInverse, quaternion, position, offsetQuaternion, offsetPosition);
+    // Offsets of rigidly mounted tools converge and then only move with the
+    // group, so their step is skipped
+    if (!Kernels::SnapToInput(inputOffsetQuaternion, inputOffsetPosition,
+                              state.ConvergencePositionTolerance2, state.ConvergenceDotTolerance,
+                              offsetQuaternion, offsetPosition))
+      {
+      Kernels::FilterStep(Algorithm(), state.SlerpCoefficients, state.GroupOffsetBlendFactors, 0.0,
+                          inputOffsetQuaternion, inputOffsetPosition, offsetQuaternion, offsetPosition);
+      }
+    ComposePoses(state.GroupFiltered, offsetQuaternion, offsetPosition, quaternion, position);
+    }
+  else
+    {
+    Kernels::FilterStep(Algorithm(), state.SlerpCoefficients, alpha, state.ToolFrame,
+                        inputQuaternion, inputPosition, quaternion, position);
+    }
+  Kernels::NormalizePeriodically(quaternion, state.StepsSinceNormalization);
+  vtkInternal::UpdateConverged(state, inputQuaternion, inputPosition);
+  PoseToMatrix(quaternion, position, state.OutputMatrix);
+  vtkInternal::ComposeReference(state);
+}
+
+//----------------------------------------------------------------------------
+template <>
+void vtkSlicerTrackerStabilizerLogic::vtkInternal
+::Compute<Kernels::PassThroughFilter, false>(vtkSlicerTrackerStabilizerLogic*, FilterState& state)
+{
+  // No filter. Output Transform = Input Transform
+  memcpy(state.OutputMatrix, state.InputMatrix, sizeof(state.OutputMatrix));
+  state.MotionInitialized = false;
+
+  // Follow the input so that filtering starts from it when activated
+  double quaternion[4];
+  MatrixToPose(state.InputMatrix, quaternion, state.Position);
+  Kernels::SetQuaternionInHemisphere(state.Quaternion, quaternion);
+  vtkInternal::ComposeReference(state);
+  state.Converged = true;
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerTrackerStabilizerLogic);
+
+//----------------------------------------------------------------------------
+vtkSlicerTrackerStabilizerLogic::vtkSlicerTrackerStabilizerLogic()
+{
+  this->Internal = new vtkInternal;
+  this->NumberOfThreads = 1;
+  this->SweepInParallel = true;
+  this->NetworkMaximumSendRate = 0.0;
+  this->SinglePrecision = false;
+  this->SlerpTolerance = 0.0;
+  this->SlerpNumberOfTerms = -1;
+  this->DiagnosticsRate = 0.0;
+  this->FilterDeadline = 0.0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerTrackerStabilizerLogic::~vtkSlicerTrackerStabilizerLogic()
+{
+  vtkInternal::SequenceJob& job = this->Internal->Sequence;
+  if (job.ThreadID >= 0)
+    {
+    job.Cancel.store(1, std::memory_order_relaxed);
+    this->Internal->SequenceThreader->TerminateThread(job.ThreadID);
+    }
+  for (vtkInternal::DiagnosticsBufferMap::iterator it = this->Internal->DiagnosticsBuffers.begin();
+       it != this->Internal->DiagnosticsBuffers.end(); ++it)
+    {
+    delete it->second;
+    }
+  delete this->Internal;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "Number of active filters: " << this->GetNumberOfActiveFilters() << std::endl;
+  os << indent << "Number of threads: " << this->NumberOfThreads << std::endl;
+  os << indent << "Sweep in parallel: " << this->SweepInParallel << std::endl;
+  os << indent << "Single precision: " << this->SinglePrecision << std::endl;
+  os << indent << "Slerp tolerance: " << this->SlerpTolerance << std::endl;
+  os << indent << "Slerp number of terms: " << this->SlerpNumberOfTerms << std::endl;
+  os << indent << "Shared memory output: " << this->GetSharedMemoryOutputActive() << std::endl;
+  os << indent << "Network output: " << this->GetNetworkOutputActive() << std::endl;
+  os << indent << "Network maximum send rate: " << this->NetworkMaximumSendRate << std::endl;
+  os << indent << "Filter deadline: " << this->FilterDeadline << std::endl;
+  os << indent << "Tracing: " << (this->GetTracing() ? "On" : "Off") << std::endl;
+  os << indent << "Diagnostics rate: " << this->DiagnosticsRate << std::endl;
+  os << indent << "Sequence filtering: " << this->GetSequenceFilteringActive() << std::endl;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
+{
+  vtkNew<vtkIntArray> events;
+  events->InsertNextValue(vtkMRMLScene::NodeAddedEvent);
+  events->InsertNextValue(vtkMRMLScene::NodeRemovedEvent);
+  events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
+  this->SetAndObserveMRMLSceneEventsInternal(newScene, events.GetPointer());
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic::RegisterNodes()
+{
+  if( !this->GetMRMLScene() )
+    {
+    vtkWarningMacro( "MRML scene not yet created" );
+    return;
+    }
+
+  this->GetMRMLScene()->RegisterNodeClass( vtkSmartPointer< vtkMRMLTrackerStabilizerNode >::New() );
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic::UpdateFromMRMLScene()
+{
+  assert(this->GetMRMLScene() != 0);
+
+  // Rebuild the active set after batch processing (scene import/close), when
+  // node references may have been resolved without individual events.
+  // Existing filter states are kept.
+  vtkInternal::FilterStateVector activeFilters;
+  vtkCollection* filteringNodes = this->GetMRMLScene()->GetNodesByClass("vtkMRMLTrackerStabilizerNode");
+  for (int i = 0; i < filteringNodes->GetNumberOfItems(); ++i)
+    {
+    vtkMRMLTrackerStabilizerNode* tsNode = vtkMRMLTrackerStabilizerNode::SafeDownCast(
+      filteringNodes->GetItemAsObject(i));
+    if (tsNode == NULL || tsNode->GetID() == NULL ||
+        tsNode->GetInputTransformNode() == NULL || tsNode->GetFilteredTransformNode() == NULL)
+      {
+      continue;
+      }
+    FilterState* existingState = this->Internal->Find(tsNode);
+    activeFilters.push_back(existingState ? *existingState : FilterState());
+    activeFilters.back().Node = tsNode;
+    activeFilters.back().NodeID = tsNode->GetID();
+    }
+  filteringNodes->Delete();
+
+  std::sort(activeFilters.begin(), activeFilters.end(), FilterStateLess);
+  this->Internal->ActiveFilters.swap(activeFilters);
+  this->Internal->ScheduleModified = true;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::OnMRMLSceneNodeAdded(vtkMRMLNode* node)
+{
+  if ( node == NULL || this->GetMRMLScene() == NULL )
+    {
+    vtkWarningMacro( "OnMRMLSceneNodeAdded: Invalid MRML scene or node" );
+    return;
+    }
+
+  if ( node->IsA( "vtkMRMLTrackerStabilizerNode" ) )
+    {
+    vtkDebugMacro( "OnMRMLSceneNodeAdded: Module node added." );
+    vtkUnObserveMRMLNodeMacro( node );
+    vtkNew<vtkIntArray> events;
+    events->InsertNextValue( vtkCommand::ModifiedEvent );
+    events->InsertNextValue( vtkMRMLTrackerStabilizerNode::InputDataModifiedEvent );
+    vtkObserveMRMLNodeEventsMacro( node, events.GetPointer() );
+    this->UpdateActiveFilter( vtkMRMLTrackerStabilizerNode::SafeDownCast( node ) );
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::OnMRMLSceneNodeRemoved(vtkMRMLNode* node)
+{
+  if ( node == NULL || this->GetMRMLScene() == NULL )
+    {
+    vtkWarningMacro( "OnMRMLSceneNodeRemoved: Invalid MRML scene or node" );
+    return;
+    }
+
+  if ( node->IsA( "vtkMRMLTrackerStabilizerNode" ) )
+    {
+    vtkDebugMacro( "OnMRMLSceneNodeRemoved" );
+    vtkUnObserveMRMLNodeMacro( node );
+    this->RemoveActiveFilter( vtkMRMLTrackerStabilizerNode::SafeDownCast( node ) );
+    if ( node->GetID() )
+      {
+      this->Internal->RemoveDiagnosticsBuffer( node->GetID() );
+      }
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::ProcessMRMLNodesEvents( vtkObject* caller, unsigned long event, void* /*callData*/)
+{
+  vtkMRMLNode* callerNode = vtkMRMLNode::SafeDownCast( caller );
+  if ( callerNode == NULL )
+    {
+    return;
+    }
+
+  vtkMRMLTrackerStabilizerNode* tsNode = vtkMRMLTrackerStabilizerNode::SafeDownCast( callerNode );
+  if ( tsNode == NULL )
+    {
+    return;
+    }
+  vtkTrackerStabilizerTraceMacro( "Event", tsNode->GetID() );
+
+  if ( event == vtkCommand::ModifiedEvent ||
+       event == vtkMRMLTrackerStabilizerNode::InputDataModifiedEvent )
+    {
+    // Input or output references may have changed
+    this->UpdateActiveFilter( tsNode );
+    }
+
+  if ( event == vtkCommand::ModifiedEvent )
+    {
+    // Parameters may have changed, select the filter again before next step
+    FilterState* state = this->Internal->Find( tsNode );
+    if ( state )
+      {
+      state->Configured = false;
+      }
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::UpdateActiveFilter(vtkMRMLTrackerStabilizerNode* tsNode)
+{
+  if ( tsNode == NULL || tsNode->GetID() == NULL )
+    {
+    return;
+    }
+
+  const bool active = ( tsNode->GetInputTransformNode() != NULL &&
+                        tsNode->GetFilteredTransformNode() != NULL );
+
+  vtkInternal::FilterStateVector& activeFilters = this->Internal->ActiveFilters;
+  vtkInternal::FilterStateVector::iterator it = this->Internal->LowerBound( tsNode->GetID() );
+  const bool found = ( it != activeFilters.end() && it->Node == tsNode );
+  if ( active && !found )
+    {
+    it = activeFilters.insert( it, FilterState() );
+    it->Node = tsNode;
+    it->NodeID = tsNode->GetID();
+    this->Internal->ScheduleModified = true;
+    }
+  else if ( !active && found )
+    {
+    activeFilters.erase( it );
+    this->Internal->ScheduleModified = true;
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::RemoveActiveFilter(vtkMRMLTrackerStabilizerNode* tsNode)
+{
+  if ( tsNode == NULL || tsNode->GetID() == NULL )
+    {
+    return;
+    }
+
+  vtkInternal::FilterStateVector& activeFilters = this->Internal->ActiveFilters;
+  vtkInternal::FilterStateVector::iterator it = this->Internal->LowerBound( tsNode->GetID() );
+  if ( it != activeFilters.end() && it->Node == tsNode )
+    {
+    activeFilters.erase( it );
+    this->Internal->ScheduleModified = true;
+    }
+}
+
+//---------------------------------------------------------------------------
+int vtkSlicerTrackerStabilizerLogic
+::GetNumberOfActiveFilters()
+{
+  return static_cast<int>( this->Internal->ActiveFilters.size() );
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::FilterActiveNodes()
+{
+  vtkInternal::FilterStateVector& activeFilters = this->Internal->ActiveFilters;
+  if (activeFilters.empty())
+    {
+    return;
+    }
+
+  vtkTrackerStabilizerTraceMacro("FilterActiveNodes", NULL);
+  if (this->Internal->ScheduleModified)
+    {
+    this->Internal->UpdateSchedule();
+    }
+  const std::vector<size_t>& schedule = this->Internal->Schedule;
+
+  // Read all inputs from MRML first, then filter without touching MRML, so
+  // that filters can be computed in parallel. Nodes are served by decreasing
+  // priority, then node ID, whatever the number of threads: when several
+  // filters share an output node, the last one in that order wins.
+  // The deadline is applied when publishing, in that order, so that all
+  // filter states step and only the outputs of lower priority are shed. A
+  // shed output is published at a later tick, unless a new sample of the
+  // node supersedes it (the filter state already contains it).
+  const double time = vtkTimerLog::GetUniversalTime();
+  const double deadline = (this->FilterDeadline > 0.0) ? time + this->FilterDeadline : 0.0;
+  const int highestPriority = activeFilters[schedule[0]].Priority;
+  const vtkIdType numberOfFilters = static_cast<vtkIdType>(activeFilters.size());
+  vtkIdType numberOfSamples = 0;
+  vtkIdType numberOfPendingOutputs = 0;
+  for (size_t k = 0; k < schedule.size(); ++k)
+    {
+    FilterState& state = activeFilters[schedule[k]];
+    if (time < state.NextUpdateTime)
+      {
+      // Rate limited, the input stays pending until the output is due
+      state.Valid = false;
+      }
+    else if (this->GatherFilterInput(state, time))
+      {
+      ++numberOfSamples;
+      }
+    if (state.PublishPending)
+      {
+      ++numberOfPendingOutputs;
+      }
+    }
+  this->Internal->ReferencePoses.clear();
+  if (numberOfSamples == 0)
+    {
+    // All inputs unchanged and all filters converged
+    if (numberOfPendingOutputs > 0)
+      {
+      this->PublishScheduledFilterOutputs(deadline, highestPriority);
+      }
+    return;
+    }
+  this->UpdateFilterGroups();
+
+  vtkInternal::ComputeFunctor compute(this, &activeFilters[0]);
+  if (this->SinglePrecision)
+    {
+    this->ComputeFiltersInSinglePrecision();
+    }
+  else if (this->NumberOfThreads != 1 && numberOfFilters > 1)
+    {
+    const vtkIdType grain = 8;
+    vtkSMPTools::For(0, numberOfFilters, grain, compute);
+    }
+  else
+    {
+    compute(0, numberOfFilters);
+    }
+
+  // One network frame for all the tools of the tick
+  if (this->Internal->NetworkSender.IsOpen() &&
+      (this->NetworkMaximumSendRate <= 0.0 ||
+       time - this->Internal->NetworkLastSendTime >= 1.0 / this->NetworkMaximumSendRate))
+    {
+    vtkTrackerStabilizerTraceMacro("SendNetworkFrame", NULL);
+    this->SendNetworkFrame(time);
+    }
+
+  this->PublishScheduledFilterOutputs(deadline, highestPriority);
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::PublishScheduledFilterOutputs(double deadline, int highestPriority)
+{
+  // Index-based loops: publishing an output fires node events that may update
+  // the active set. When the active set or a priority has changed, the
+  // remaining outputs are published in node ID order.
+  vtkInternal::FilterStateVector& activeFilters = this->Internal->ActiveFilters;
+  const std::vector<size_t>& schedule = this->Internal->Schedule;
+  for (size_t k = 0; k < schedule.size() && !this->Internal->ScheduleModified; ++k)
+    {
+    this->PublishScheduledFilterOutput(activeFilters[schedule[k]], deadline, highestPriority);
+    }
+  for (size_t i = 0; i < activeFilters.size() && this->Internal->ScheduleModified; ++i)
+    {
+    this->PublishScheduledFilterOutput(activeFilters[i], deadline, highestPriority);
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::PublishScheduledFilterOutput(FilterState& state, double deadline, int highestPriority)
+{
+  if (!state.Valid && !state.PublishPending)
+    {
+    return;
+    }
+  state.Valid = true;
+  if (deadline > 0.0 && vtkTimerLog::GetUniversalTime() > deadline)
+    {
+    ++state.NumberOfMissedDeadlines;
+    if (state.Priority < highestPriority)
+      {
+      // Keep the computed output for a later tick. External readers do not
+      // wait for MRML, they get it now.
+      if (!state.PublishPending)
+        {
+        ++state.NumberOfShedUpdates;
+        this->WriteSharedMemoryOutput(state);
+        state.PublishPending = true;
+        }
+      state.Valid = false;
+      return;
+      }
+    }
+  if (state.MinimumUpdateInterval > 0.0)
+    {
+    state.NextUpdateTime = state.SampleTime + state.MinimumUpdateInterval - UpdateIntervalTolerance;
+    }
+  this->PublishFilterOutput(state);
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::SetNumberOfThreads(int numberOfThreads)
+{
+  numberOfThreads = std::max(numberOfThreads, 0);
+  if (this->NumberOfThreads == numberOfThreads)
+    {
+    return;
+    }
+  this->NumberOfThreads = numberOfThreads;
+  if (numberOfThreads != 1)
+    {
+    vtkSMPTools::Initialize(numberOfThreads);
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+// Spherical linear interpolation between two rotation quaternions.
+// t is a value between 0 and 1 that interpolates between from and to (t=0 means the results is the same as "from").
+// Precondition: no aliasing problems to worry about ("result" can be "from" or "to" param).
+// Parameters: adjustSign - If true, then slerp will operate by adjusting the sign of the slerp to take shortest path. True is recommended, otherwise the interpolation sometimes give unexpected results. 
+// References: From Adv Anim and Rendering Tech. Pg 364
+
+void vtkSlicerTrackerStabilizerLogic
+::Slerp(double *result, double t, double *from, double *to, bool adjustSign)
+{
+  if (adjustSign)
+  {
+    // Shortest path, interpolated linearly only where it is exact
+    Kernels::Slerp(result, t, from, to);
+    return;
+  }
+
+  // calc cosine theta
+  double cosom = from[0]*to[0]+from[1]*to[1]+from[2]*to[2]+from[3]*to[3]; // dot( from, to )
+
+  // Calculate coefficients
+  double sclp, sclq;
+  if (((double)1.0 - cosom) > std::numeric_limits<double>::epsilon())
+  {
+    // Standard case (slerp)
+    double omega, sinom;
+    omega = acos( cosom ); // extract theta from dot product's cos theta
+    sinom = sin( omega );
+    sclp  = sin( ((double)1.0 - t) * omega ) / sinom;
+    sclq  = sin( t * omega ) / sinom;
+  }
+  else
+  {
+    // Equal to double precision, linear interpolation is exact
+    sclp = (double)1.0 - t;
+    sclq = t;
+  }
+
+  for (int i=0; i<4; i++)
+  {
+    result[i] = sclp * from[i] + sclq * to[i];
+  }
+}
+
+//----------------------------------------------------------------------------
+// Interpolate the matrix for the given timestamp from the two nearest
+// transforms in the buffer.
+// The rotation is interpolated with SLERP interpolation, and the
+// position is interpolated with linear interpolation.
+// The flags correspond to the closest element.
+
+void vtkSlicerTrackerStabilizerLogic
+::GetInterpolatedTransform(vtkMatrix4x4* itemAmatrix, vtkMatrix4x4* itemBmatrix, 
+			   double itemAweight, double itemBweight,
+			   vtkMatrix4x4* interpolatedMatrix)
+{
+  this->InterpolateTransform(itemAmatrix->Element, itemBmatrix->Element,
+                             itemAweight, itemBweight, interpolatedMatrix->Element);
+  interpolatedMatrix->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::InterpolateTransform(const double itemAmatrix[4][4], const double itemBmatrix[4][4],
+                       double itemAweight, double itemBweight,
+                       double interpolatedMatrix[4][4])
+{
+  double itemAweightNormalized=itemAweight/(itemAweight+itemBweight);
+  double itemBweightNormalized=itemBweight/(itemAweight+itemBweight);
+
+  double matrixA[3][3]={{0,0,0},{0,0,0},{0,0,0}};
+  for (int i = 0; i < 3; i++)
+  {
+    matrixA[i][0] = itemAmatrix[i][0];
+    matrixA[i][1] = itemAmatrix[i][1];
+    matrixA[i][2] = itemAmatrix[i][2];
+  }
+
+  double matrixB[3][3] = {{0,0,0}, {0,0,0}, {0,0,0}};
+  for (int i = 0; i < 3; i++)
+  {
+    matrixB[i][0] = itemBmatrix[i][0];
+    matrixB[i][1] = itemBmatrix[i][1];
+    matrixB[i][2] = itemBmatrix[i][2];
+  }
+
+  double matrixAquat[4]= {0,0,0,0};
+  vtkMath::Matrix3x3ToQuaternion(matrixA, matrixAquat);
+  double matrixBquat[4]= {0,0,0,0};
+  vtkMath::Matrix3x3ToQuaternion(matrixB, matrixBquat);
+  double interpolatedRotationQuat[4]= {0,0,0,0};
+  Slerp(interpolatedRotationQuat, itemBweightNormalized, matrixAquat, matrixBquat);
+  double interpolatedRotation[3][3] = {{0,0,0},{0,0,0},{0,0,0}};
+  vtkMath::QuaternionToMatrix3x3(interpolatedRotationQuat, interpolatedRotation);
+
+  for (int i = 0; i < 3; i++)
+  {
+    interpolatedMatrix[i][0] = interpolatedRotation[i][0];
+    interpolatedMatrix[i][1] = interpolatedRotation[i][1];
+    interpolatedMatrix[i][2] = interpolatedRotation[i][2];
+    interpolatedMatrix[i][3] = itemAmatrix[i][3]*itemAweightNormalized +
+      itemBmatrix[i][3]*itemBweightNormalized;
+  }
+  interpolatedMatrix[3][0] = 0.0;
+  interpolatedMatrix[3][1] = 0.0;
+  interpolatedMatrix[3][2] = 0.0;
+  interpolatedMatrix[3][3] = 1.0;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::Filter(vtkMRMLTrackerStabilizerNode* tsNode)
+{
+  if ( tsNode == NULL )
+    {
+    return;
+    }
+
+  // Nodes that are not in the active set (e.g. not in the scene) are
+  // filtered without history
+  FilterState temporaryState;
+  FilterState* state = this->Internal->Find(tsNode);
+  if (state == NULL)
+    {
+    temporaryState.Node = tsNode;
+    state = &temporaryState;
+    }
+
+  const bool gathered = this->GatherFilterInput(*state, vtkTimerLog::GetUniversalTime());
+  this->Internal->ReferencePoses.clear();
+  if (gathered)
+    {
+    this->ComputeFilter(*state);
+    this->PublishFilterOutput(*state);
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerTrackerStabilizerLogic
+::GatherFilterInput(FilterState& state, double time)
+{
+  vtkTrackerStabilizerTraceMacro("Gather", state.NodeID.c_str());
+  state.Valid = false;
+
+  vtkMRMLTrackerStabilizerNode* tsNode = state.Node;
+  vtkMRMLLinearTransformNode* inputNode = tsNode->GetInputTransformNode();
+  vtkMRMLLinearTransformNode* outputNode = tsNode->GetFilteredTransformNode();
+
+  if ( inputNode == NULL || outputNode == NULL)
+    {
+    return false;
+    }
+
+  // Nothing to do while the input has not been modified and the output has
+  // reached it, so that idle tools cost almost nothing. Only parameter
+  // changes clear Configured (the motion state does not modify the node),
+  // and they publish the output once more.
+  vtkMRMLLinearTransformNode* referenceNode = tsNode->GetReferenceTransformNode();
+  const unsigned long inputMTime = inputNode->GetMTime();
+  const unsigned long referenceMTime = referenceNode ? referenceNode->GetMTime() : 0;
+  if (state.Converged && state.Configured &&
+      inputNode == state.InputNode && referenceNode == state.ReferenceNode &&
+      inputMTime == state.InputMTime && referenceMTime == state.ReferenceMTime)
+    {
+    return false;
+    }
+  state.InputMTime = inputMTime;
+  state.ReferenceMTime = referenceMTime;
+
+  // Get matrices
+  vtkMatrix4x4* matrix = this->Internal->TransferMatrix;
+  inputNode->GetMatrixTransformToParent(matrix);
+  memcpy(state.InputMatrix, matrix->Element, sizeof(state.InputMatrix));
+
+  // Start again from the warm start pose when the filter targets other
+  // nodes. The saved state is in the frame of the previous reference.
+  if (state.Initialized &&
+      (inputNode != state.InputNode || outputNode != state.OutputNode ||
+       referenceNode != state.ReferenceNode))
+    {
+    tsNode->ClearFilterState();
+    state.Initialized = false;
+    }
+  state.InputNode = inputNode;
+  state.OutputNode = outputNode;
+  state.ReferenceNode = referenceNode;
+  const double* referenceInverse = NULL;
+  if (referenceNode)
+    {
+    const vtkInternal::ReferencePose& reference = this->Internal->GetReferencePose(referenceNode);
+    memcpy(state.ReferenceMatrix, reference.Matrix, sizeof(state.ReferenceMatrix));
+    referenceInverse = &reference.Inverse[0][0];
+    vtkMatrix4x4::Multiply4x4(referenceInverse, &matrix->Element[0][0], &state.InputMatrix[0][0]);
+    }
+
+  if (!state.Initialized)
+    {
+    if (tsNode->GetFilterState(state.Quaternion, state.Position))
+      {
+      // Resume from the state saved with the scene, only once
+      tsNode->ClearFilterState();
+      NormalizeQuaternion(state.Quaternion);
+      }
+    else if (tsNode->GetWarmStartMode() == vtkMRMLTrackerStabilizerNode::WarmStartFromInput)
+      {
+      // Start at the input, so that the output does not move
+      MatrixToPose(state.InputMatrix, state.Quaternion, state.Position);
+      }
+    else
+      {
+      // Start from the current output, later samples use the filter state
+      outputNode->GetMatrixTransformToParent(matrix);
+      double output[4][4];
+      memcpy(output, matrix->Element, sizeof(output));
+      if (referenceInverse)
+        {
+        vtkMatrix4x4::Multiply4x4(referenceInverse, &matrix->Element[0][0], &output[0][0]);
+        }
+      MatrixToPose(output, state.Quaternion, state.Position);
+      }
+    if (state.Quaternion[0] < 0.0)
+      {
+      for (int i = 0; i < 4; ++i)
+        {
+        state.Quaternion[i] = -state.Quaternion[i];
+        }
+      }
+    state.StepsSinceNormalization = 0;
+    state.PositionNoise2 = 0.0;
+    state.RotationNoise2 = 0.0;
+    state.Converged = false;
+    state.Initialized = true;
+    }
+
+  if (!state.Configured)
+    {
+    this->ConfigureFilter(state);
+    }
+
+  state.SampleTime = time;
+  state.Valid = true;
+  // The filter state already contains the output shed at a previous tick
+  state.PublishPending = false;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::UpdateFilterGroups()
+{
+  vtkInternal::FilterStateVector& activeFilters = this->Internal->ActiveFilters;
+  vtkInternal::GroupStateMap& groups = this->Internal->Groups;
+  bool grouped = !groups.empty();
+  for (size_t i = 0; i < activeFilters.size() && !grouped; ++i)
+    {
+    grouped = (activeFilters[i].GroupID != 0);
+    }
+  if (!grouped)
+    {
+    return;
+    }
+  vtkTrackerStabilizerTraceMacro("UpdateFilterGroups", NULL);
+
+  for (vtkInternal::GroupStateMap::iterator it = groups.begin(); it != groups.end(); ++it)
+    {
+    vtkInternal::GroupState& group = it->second;
+    group.NumberOfMembers = 0;
+    group.NumberOfSamples = 0;
+    group.Leader = NULL;
+    }
+
+  // Mean input pose of each group, from the last input of every member so
+  // that the group frame does not depend on which inputs were modified
+  for (size_t i = 0; i < activeFilters.size(); ++i)
+    {
+    FilterState& state = activeFilters[i];
+    state.GroupActive = false;
+    if (state.GroupID == 0 || !state.Initialized)
+      {
+      continue;
+      }
+    vtkInternal::GroupState& group = groups[state.GroupID];
+    if (group.NumberOfMembers > 0 && state.ReferenceNode != group.Leader->ReferenceNode)
+      {
+      // Poses relative to different references cannot be averaged
+      if (!state.GroupRejected)
+        {
+        vtkWarningMacro("UpdateFilterGroups: " << state.NodeID << " does not have the reference of "
+                        << group.Leader->NodeID << ", it is not filtered with group " << state.GroupID);
+        state.GroupRejected = true;
+        }
+      continue;
+      }
+    state.GroupRejected = false;
+    double quaternion[4];
+    double position[3];
+    MatrixToPose(state.InputMatrix, quaternion, position);
+    if (group.NumberOfMembers == 0)
+      {
+      group.Leader = &state;
+      memset(group.QuaternionSum, 0, sizeof(group.QuaternionSum));
+      memset(group.PositionSum, 0, sizeof(group.PositionSum));
+      if (!group.Initialized)
+        {
+        memcpy(group.Filtered.Quaternion, quaternion, sizeof(quaternion));
+        }
+      }
+    const double* hemisphere = group.Filtered.Quaternion;
+    const double sign = (hemisphere[0]*quaternion[0] + hemisphere[1]*quaternion[1] +
+                         hemisphere[2]*quaternion[2] + hemisphere[3]*quaternion[3] < 0.0) ? -1.0 : 1.0;
+    for (int c = 0; c < 4; ++c)
+      {
+      group.QuaternionSum[c] += sign*quaternion[c];
+      }
+    for (int c = 0; c < 3; ++c)
+      {
+      group.PositionSum[c] += position[c];
+      }
+    ++group.NumberOfMembers;
+    if (state.Valid)
+      {
+      ++group.NumberOfSamples;
+      }
+    }
+
+  // Filter the common motion once per group
+  vtkInternal::GroupStateMap::iterator it = groups.begin();
+  while (it != groups.end())
+    {
+    vtkInternal::GroupState& group = it->second;
+    if (group.NumberOfMembers == 0)
+      {
+      groups.erase(it++);
+      continue;
+      }
+    ++it;
+    if (group.NumberOfSamples == 0)
+      {
+      continue;
+      }
+    RigidPose mean;
+    memcpy(mean.Quaternion, group.QuaternionSum, sizeof(mean.Quaternion));
+    NormalizeQuaternion(mean.Quaternion);
+    for (int c = 0; c < 3; ++c)
+      {
+      mean.Position[c] = group.PositionSum[c] / group.NumberOfMembers;
+      }
+    if (!group.Initialized)
+      {
+      group.Filtered = mean;
+      group.Initialized = true;
+      }
+    InvertPose(group.Filtered.Quaternion, group.Filtered.Position, group.PreviousInverse);
+    // Weights of the leader as in its own step. Its motion state and tool
+    // tip tuning are updated when it is computed, so they are those of its
+    // previous sample.
+    const FilterState& leader = *group.Leader;
+    const double* alpha = (leader.MotionInitialized && leader.Node->GetMotionDetection()) ?
+      leader.BlendFactors : leader.StationaryBlendFactors;
+    Kernels::FilterStep(Kernels::LowPassFilter(), group.SlerpCoefficients, alpha, 0.0,
+                        mean.Quaternion, mean.Position, group.Filtered.Quaternion, group.Filtered.Position);
+    NormalizeQuaternion(group.Filtered.Quaternion);
+    const double cosHalfAngle = fabs(
+      mean.Quaternion[0]*group.Filtered.Quaternion[0] + mean.Quaternion[1]*group.Filtered.Quaternion[1] +
+      mean.Quaternion[2]*group.Filtered.Quaternion[2] + mean.Quaternion[3]*group.Filtered.Quaternion[3]);
+    group.Converged =
+      vtkMath::Distance2BetweenPoints(mean.Position, group.Filtered.Position) <= leader.ConvergencePositionTolerance2 &&
+      1.0 - cosHalfAngle <= leader.ConvergenceDotTolerance;
+    InvertPose(mean.Quaternion, mean.Position, group.InputInverse);
+    }
+
+  // Hand the poses of the group to the members that filter this tick. While
+  // the common motion moves, all members are filtered again next tick.
+  for (size_t i = 0; i < activeFilters.size(); ++i)
+    {
+    FilterState& state = activeFilters[i];
+    if (state.GroupID == 0 || !state.Initialized || state.GroupRejected)
+      {
+      continue;
+      }
+    const vtkInternal::GroupState& group = groups[state.GroupID];
+    if (!group.Converged)
+      {
+      state.Converged = false;
+      }
+    if (!state.Valid || group.NumberOfSamples == 0)
+      {
+      continue;
+      }
+    state.GroupInputInverse = group.InputInverse;
+    state.GroupPreviousInverse = group.PreviousInverse;
+    state.GroupFiltered = group.Filtered;
+    state.GroupActive = true;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::ComputeFilter(FilterState& state)
+{
+  if (!state.Valid)
+    {
+    return;
+    }
+  vtkTrackerStabilizerTraceMacro("Compute", state.NodeID.c_str());
+  if (this->DiagnosticsRate > 0.0)
+    {
+    const double start = vtkTimerLog::GetUniversalTime();
+    state.Compute(this, state);
+    state.ComputeTime = vtkTimerLog::GetUniversalTime() - start;
+    }
+  else
+    {
+    state.Compute(this, state);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::ConfigureFilter(FilterState& state)
+{
+  vtkMRMLTrackerStabilizerNode* tsNode = state.Node;
+
+  // Scheduling. Rate-limited outputs are updated less often, the weights
+  // are computed for their interval.
+  if (state.Priority != tsNode->GetPriority())
+    {
+    state.Priority = tsNode->GetPriority();
+    this->Internal->ScheduleModified = true;
+    }
+  const double maximumUpdateRate = tsNode->GetMaximumUpdateRate();
+  state.MinimumUpdateInterval = (maximumUpdateRate > 0.0) ? 1.0 / maximumUpdateRate : 0.0;
+  if (state.MinimumUpdateInterval == 0.0)
+    {
+    state.NextUpdateTime = 0.0;
+    }
+  state.TimeStep = std::max(FilterTimeStep, state.MinimumUpdateInterval);
+  state.GroupID = tsNode->GetGroupID();
+  const double groupOffsetBlendFactor =
+    Kernels::BlendFactorFromCutOffFrequency(tsNode->GetGroupOffsetCutOffFrequency(), state.TimeStep);
+  for (int i = 0; i < 4; i++)
+    {
+    state.GroupOffsetBlendFactors[i] = groupOffsetBlendFactor;
+    }
+
+  // Compute weights (low-pass filter with w_cutoff frequency)
+  tsNode->GetEffectiveCutOffFrequencies(state.CutOffFrequencies);
+  for (int i = 0; i < 4; i++)
+    {
+    state.RestBlendFactors[i] = Kernels::BlendFactorFromCutOffFrequency(state.CutOffFrequencies[i], state.TimeStep);
+    }
+
+  const double targetToolTipJitter = tsNode->GetTargetToolTipJitter();
+  double* toolTipOffset = tsNode->GetToolTipOffset();
+  state.ToolTipTuning = targetToolTipJitter > 0.0;
+  state.TargetToolTipJitter2 = targetToolTipJitter*targetToolTipJitter;
+  state.ToolTipLeverArm2 = vtkMath::Dot(toolTipOffset, toolTipOffset);
+  vtkInternal::UpdateStationaryBlendFactors(state);
+
+  const double positionTolerance = std::max(tsNode->GetConvergencePositionTolerance(), 0.0);
+  const double rotationTolerance = std::max(tsNode->GetConvergenceRotationTolerance(), 0.0);
+  state.ConvergencePositionTolerance2 = positionTolerance*positionTolerance;
+  state.ConvergenceDotTolerance = 1.0 - cos(0.5*vtkMath::RadiansFromDegrees(rotationTolerance));
+  state.ToolFrame =
+    (tsNode->GetTranslationCutOffFrame() == vtkMRMLTrackerStabilizerNode::CutOffFrameTool) ? 1.0 : 0.0;
+
+  state.Algorithm = this->GetFilterAlgorithm(tsNode);
+  if (state.Algorithm == Kernels::PassThroughAlgorithm)
+    {
+    state.Compute = &vtkInternal::Compute<Kernels::PassThroughFilter, false>;
+    }
+  else if (state.Algorithm == Kernels::FastLowPassAlgorithm)
+    {
+    state.SlerpCoefficients.Set(state.RestBlendFactors[0], this->SlerpNumberOfTerms);
+    state.Compute = tsNode->GetMotionDetection() ?
+      &vtkInternal::Compute<Kernels::FastLowPassFilter, true> :
+      &vtkInternal::Compute<Kernels::FastLowPassFilter, false>;
+    }
+  else
+    {
+    state.Compute = tsNode->GetMotionDetection() ?
+      &vtkInternal::Compute<Kernels::LowPassFilter, true> :
+      &vtkInternal::Compute<Kernels::LowPassFilter, false>;
+    }
+  state.Configured = true;
+}
+
+//-----------------------------------------------------------------------------
+int vtkSlicerTrackerStabilizerLogic
+::GetFilterAlgorithm(vtkMRMLTrackerStabilizerNode* tsNode)
+{
+  if (tsNode->GetFilterActivated() == false)
+    {
+    return Kernels::PassThroughAlgorithm;
+    }
+  return (this->SlerpNumberOfTerms >= 0) ?
+    Kernels::FastLowPassAlgorithm : Kernels::LowPassAlgorithm;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::ComputeFiltersInSinglePrecision()
+{
+  vtkTrackerStabilizerTraceMacro("ComputeSinglePrecision", NULL);
+  vtkInternal* internal = this->Internal;
+  vtkInternal::FilterStateVector& activeFilters = internal->ActiveFilters;
+
+  // Low-pass filters go to the batch, the others are computed directly.
+  // Grouped filters too: the batch kernel steps the pose itself, not the
+  // offset from the common motion of the group.
+  internal->BatchStates.clear();
+  for (size_t i = 0; i < activeFilters.size(); ++i)
+    {
+    FilterState& state = activeFilters[i];
+    if (!state.Valid)
+      {
+      continue;
+      }
+    if (state.Algorithm == Kernels::LowPassAlgorithm && !state.GroupActive)
+      {
+      internal->BatchStates.push_back(&state);
+      }
+    else
+      {
+      this->ComputeFilter(state);
+      }
+    }
+
+  const size_t count = internal->BatchStates.size();
+  if (count == 0)
+    {
+    return;
+    }
+  // Batched nodes are stepped together, each gets an equal share of the time
+  const double start = (this->DiagnosticsRate > 0.0) ? vtkTimerLog::GetUniversalTime() : 0.0;
+  internal->BatchAlpha.resize(4*count);
+  internal->BatchToolFrame.resize(count);
+  internal->BatchInputQuaternions.resize(4*count);
+  internal->BatchInputPositions.resize(3*count);
+  internal->BatchQuaternions.resize(4*count);
+  internal->BatchPositions.resize(3*count);
+
+  for (size_t i = 0; i < count; ++i)
+    {
+    FilterState& state = *internal->BatchStates[i];
+    double inputQuaternion[4];
+    double inputPosition[3];
+    MatrixToPose(state.InputMatrix, inputQuaternion, inputPosition);
+    const double* quaternion = state.Quaternion;
+    const double* position = state.Position;
+
+    if (state.ToolTipTuning)
+      {
+      vtkInternal::UpdateToolTipTuning(state, inputQuaternion, inputPosition);
+      }
+    const double* alpha = state.StationaryBlendFactors;
+    if (state.Node->GetMotionDetection())
+      {
+      this->UpdateMotionState(state.Node, state, state.TimeStep);
+      alpha = state.BlendFactors;
+      }
+    else
+      {
+      state.MotionInitialized = false;
+      }
+
+    internal->BatchToolFrame[i] = static_cast<float>(state.ToolFrame);
+    for (int c = 0; c < 4; ++c)
+      {
+      internal->BatchAlpha[c*count + i] = static_cast<float>(alpha[c]);
+      internal->BatchInputQuaternions[c*count + i] = static_cast<float>(inputQuaternion[c]);
+      internal->BatchQuaternions[c*count + i] = static_cast<float>(quaternion[c]);
+      }
+    for (int c = 0; c < 3; ++c)
+      {
+      internal->BatchInputPositions[c*count + i] = static_cast<float>(inputPosition[c]);
+      internal->BatchPositions[c*count + i] = static_cast<float>(position[c]);
+      }
+    }
+
+  vtkInternal::BatchFunctor batch(internal);
+  if (this->NumberOfThreads != 1 && count > 1)
+    {
+    const vtkIdType grain = 64;
+    vtkSMPTools::For(0, static_cast<vtkIdType>(count), grain, batch);
+    }
+  else
+    {
+    batch(0, static_cast<vtkIdType>(count));
+    }
+
+  for (size_t i = 0; i < count; ++i)
+    {
+    FilterState& state = *internal->BatchStates[i];
+    double inputQuaternion[4];
+    double inputPosition[3];
+    for (int c = 0; c < 4; ++c)
+      {
+      state.Quaternion[c] = internal->BatchQuaternions[c*count + i];
+      inputQuaternion[c] = internal->BatchInputQuaternions[c*count + i];
+      }
+    for (int c = 0; c < 3; ++c)
+      {
+      state.Position[c] = internal->BatchPositions[c*count + i];
+      inputPosition[c] = internal->BatchInputPositions[c*count + i];
+      }
+    // Single precision rounding errors are larger, renormalize every step
+    NormalizeQuaternion(state.Quaternion);
+    vtkInternal::UpdateConverged(state, inputQuaternion, inputPosition);
+    PoseToMatrix(state.Quaternion, state.Position, state.OutputMatrix);
+    vtkInternal::ComposeReference(state);
+    }
+
+  if (this->DiagnosticsRate > 0.0)
+    {
+    const double computeTime = (vtkTimerLog::GetUniversalTime() - start) / count;
+    for (size_t i = 0; i < count; ++i)
+      {
+      internal->BatchStates[i]->ComputeTime = computeTime;
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::PublishFilterOutput(FilterState& state)
+{
+  if (!state.Valid)
+    {
+    return;
+    }
+  state.Valid = false;
+  // A shed output is already in shared memory
+  const bool sharedMemoryWritten = state.PublishPending;
+  state.PublishPending = false;
+  // The node ID is copied, the state may move while publishing
+  vtkTrackerStabilizerTraceMacro("Publish", state.NodeID.c_str());
+
+  // Publishing fires node events that may reallocate the active set, so
+  // everything needed is read from the state first
+  vtkMRMLTrackerStabilizerNode* tsNode = state.Node;
+  vtkMRMLLinearTransformNode* outputNode = tsNode->GetFilteredTransformNode();
+  if (outputNode == NULL)
+    {
+    return;
+    }
+  const int motionState = state.MotionInitialized ?
+    state.MotionState : static_cast<int>(vtkMRMLTrackerStabilizerNode::MotionStationary);
+  this->UpdateFilterMetrics(state);
+  if (this->DiagnosticsRate > 0.0)
+    {
+    this->UpdateDiagnostics(state);
+    }
+
+  // Tool tip: same rotation, position moved by the offset in the tool frame
+  vtkMRMLLinearTransformNode* toolTipNode = tsNode->GetToolTipTransformNode();
+  double toolTipMatrix[4][4];
+  if (toolTipNode)
+    {
+    const double* offset = tsNode->GetToolTipOffset();
+    memcpy(toolTipMatrix, state.OutputMatrix, sizeof(toolTipMatrix));
+    for (int i = 0; i < 3; i++)
+      {
+      toolTipMatrix[i][3] += toolTipMatrix[i][0]*offset[0] +
+        toolTipMatrix[i][1]*offset[1] + toolTipMatrix[i][2]*offset[2];
+      }
+    }
+
+  // External readers get the pose before the MRML round-trip
+  if (!sharedMemoryWritten)
+    {
+    this->WriteSharedMemoryOutput(state);
+    }
+
+  vtkMatrix4x4* matrix = this->Internal->TransferMatrix;
+  memcpy(matrix->Element, state.OutputMatrix, sizeof(state.OutputMatrix));
+  matrix->Modified();
+
+  if (tsNode->GetSaveFilterState())
+    {
+    tsNode->SetFilterState(state.Quaternion, state.Position);
+    }
+  tsNode->SetMotionState(motionState);
+
+  // Setting the TransformNode
+  outputNode->SetMatrixTransformToParent(matrix);
+
+  if (toolTipNode)
+    {
+    memcpy(matrix->Element, toolTipMatrix, sizeof(toolTipMatrix));
+    matrix->Modified();
+    toolTipNode->SetMatrixTransformToParent(matrix);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::WriteSharedMemoryOutput(FilterState& state)
+{
+  TrackerStabilizerSharedMemoryWriter& sharedMemoryWriter = this->Internal->SharedMemoryWriter;
+  vtkMRMLLinearTransformNode* outputNode = state.Node->GetFilteredTransformNode();
+  if (!sharedMemoryWriter.IsOpen() || outputNode == NULL)
+    {
+    return;
+    }
+  if (state.SharedMemoryTool < 0)
+    {
+    const char* toolName = outputNode->GetName() ? outputNode->GetName() : state.Node->GetID();
+    state.SharedMemoryTool = sharedMemoryWriter.FindOrAddTool(toolName);
+    }
+  sharedMemoryWriter.Write(state.SharedMemoryTool, state.SampleTime, &state.OutputMatrix[0][0]);
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::UpdateFilterMetrics(FilterState& state)
+{
+  vtkMRMLLinearTransformNode* groundTruthNode = state.Node->GetGroundTruthTransformNode();
+  if (groundTruthNode != state.GroundTruthNode)
+    {
+    state.GroundTruthNode = groundTruthNode;
+    state.Metrics.Reset();
+    }
+  if (groundTruthNode == NULL)
+    {
+    return;
+    }
+  vtkMatrix4x4* matrix = this->Internal->TransferMatrix;
+  groundTruthNode->GetMatrixTransformToParent(matrix);
+  double truth[4][4];
+  memcpy(truth, matrix->Element, sizeof(truth));
+
+  double truthQuaternion[4];
+  double truthPosition[3];
+  double quaternion[4];
+  double position[3];
+  MatrixToPose(truth, truthQuaternion, truthPosition);
+  MatrixToPose(state.OutputMatrix, quaternion, position);
+  AccumulateMetrics(state.Metrics, state.SampleTime, quaternion, position,
+                    truthQuaternion, truthPosition, true);
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::UpdateDiagnostics(FilterState& state)
+{
+  DiagnosticsBuffer* buffer = this->Internal->GetDiagnosticsBuffer(state);
+  buffer->NumberOfSamples++;
+  buffer->ProcessingTime += state.ComputeTime;
+  const double elapsed = state.SampleTime - buffer->LastTime;
+  if (elapsed < 1.0 / this->DiagnosticsRate)
+    {
+    return;
+    }
+
+  // Input and filter state, both relative to the reference if any
+  double inputQuaternion[4];
+  double inputPosition[3];
+  MatrixToPose(state.InputMatrix, inputQuaternion, inputPosition);
+  const vtkTypeUInt64 count = buffer->Count.load(std::memory_order_relaxed);
+  double* snapshot = buffer->Snapshots[count % DiagnosticsCapacity];
+  snapshot[DiagnosticsTime] = state.SampleTime;
+  for (int i = 0; i < 3; ++i)
+    {
+    snapshot[DiagnosticsInputPositionX + i] = inputPosition[i];
+    snapshot[DiagnosticsOutputPositionX + i] = state.Position[i];
+    }
+  snapshot[DiagnosticsInputAngle] =
+    vtkMath::DegreesFromRadians(2.0*acos(std::min(1.0, fabs(inputQuaternion[0]))));
+  snapshot[DiagnosticsOutputAngle] =
+    vtkMath::DegreesFromRadians(2.0*acos(std::min(1.0, fabs(state.Quaternion[0]))));
+  // The first snapshot has no previous one to measure the rate from
+  snapshot[DiagnosticsUpdateRate] = (count > 0) ? buffer->NumberOfSamples / elapsed : 0.0;
+  snapshot[DiagnosticsProcessingTime] = buffer->ProcessingTime / buffer->NumberOfSamples;
+  buffer->Count.store(count + 1, std::memory_order_release);
+
+  buffer->LastTime = state.SampleTime;
+  buffer->NumberOfSamples = 0;
+  buffer->ProcessingTime = 0.0;
+}
+
+//-----------------------------------------------------------------------------
+int vtkSlicerTrackerStabilizerLogic
+::GetDiagnostics(vtkMRMLTrackerStabilizerNode* tsNode, vtkDoubleArray* snapshots)
+{
+  if (snapshots == NULL)
+    {
+    return 0;
+    }
+  snapshots->SetNumberOfComponents(Diagnostics_Last);
+  snapshots->SetNumberOfTuples(0);
+  if (tsNode == NULL || tsNode->GetID() == NULL)
+    {
+    return 0;
+    }
+  vtkInternal::DiagnosticsBufferMap::iterator it = this->Internal->DiagnosticsBuffers.find(tsNode->GetID());
+  if (it == this->Internal->DiagnosticsBuffers.end())
+    {
+    return 0;
+    }
+  const DiagnosticsBuffer* buffer = it->second;
+
+  // Copy, then drop the snapshots that may have been overwritten meanwhile
+  const vtkTypeUInt64 end = buffer->Count.load(std::memory_order_acquire);
+  vtkTypeUInt64 begin = (end > DiagnosticsCapacity) ? end - DiagnosticsCapacity : 0;
+  snapshots->SetNumberOfTuples(static_cast<vtkIdType>(end - begin));
+  double* values = snapshots->GetPointer(0);
+  for (vtkTypeUInt64 i = begin; i < end; ++i)
+    {
+    memcpy(values + (i - begin)*Diagnostics_Last, buffer->Snapshots[i % DiagnosticsCapacity],
+           sizeof(buffer->Snapshots[0]));
+    }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const vtkTypeUInt64 written = buffer->Count.load(std::memory_order_relaxed);
+  const vtkTypeUInt64 firstValid = (written >= DiagnosticsCapacity) ? written - DiagnosticsCapacity + 1 : 0;
+  if (firstValid > begin)
+    {
+    const vtkIdType overwritten = static_cast<vtkIdType>(std::min(firstValid, end) - begin);
+    memmove(values, values + overwritten*Diagnostics_Last,
+            (end - begin - overwritten)*sizeof(buffer->Snapshots[0]));
+    snapshots->SetNumberOfTuples(static_cast<vtkIdType>(end - begin) - overwritten);
+    }
+  snapshots->Modified();
+  return static_cast<int>(snapshots->GetNumberOfTuples());
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::SetDiagnosticsRate(double rate)
+{
+  rate = std::max(rate, 0.0);
+  if (this->DiagnosticsRate == rate)
+    {
+    return;
+    }
+  this->DiagnosticsRate = rate;
+  this->Modified();
+}
+
+//-----------------------------------------------------------------------------
+vtkTypeInt64 vtkSlicerTrackerStabilizerLogic
+::GetNumberOfMissedDeadlines(vtkMRMLTrackerStabilizerNode* tsNode)
+{
+  if (tsNode)
+    {
+    FilterState* state = this->Internal->Find(tsNode);
+    return state ? state->NumberOfMissedDeadlines : 0;
+    }
+  vtkTypeInt64 numberOfMissedDeadlines = 0;
+  vtkInternal::FilterStateVector& activeFilters = this->Internal->ActiveFilters;
+  for (size_t i = 0; i < activeFilters.size(); ++i)
+    {
+    numberOfMissedDeadlines += activeFilters[i].NumberOfMissedDeadlines;
+    }
+  return numberOfMissedDeadlines;
+}
+
+//-----------------------------------------------------------------------------
+vtkTypeInt64 vtkSlicerTrackerStabilizerLogic
+::GetNumberOfShedUpdates(vtkMRMLTrackerStabilizerNode* tsNode)
+{
+  if (tsNode)
+    {
+    FilterState* state = this->Internal->Find(tsNode);
+    return state ? state->NumberOfShedUpdates : 0;
+    }
+  vtkTypeInt64 numberOfShedUpdates = 0;
+  vtkInternal::FilterStateVector& activeFilters = this->Internal->ActiveFilters;
+  for (size_t i = 0; i < activeFilters.size(); ++i)
+    {
+    numberOfShedUpdates += activeFilters[i].NumberOfShedUpdates;
+    }
+  return numberOfShedUpdates;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::ResetSchedulingCounters(vtkMRMLTrackerStabilizerNode* tsNode)
+{
+  vtkInternal::FilterStateVector& activeFilters = this->Internal->ActiveFilters;
+  for (size_t i = 0; i < activeFilters.size(); ++i)
+    {
+    if (tsNode == NULL || activeFilters[i].Node == tsNode)
+      {
+      activeFilters[i].NumberOfMissedDeadlines = 0;
+      activeFilters[i].NumberOfShedUpdates = 0;
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::SetTracing(bool tracing)
+{
+  if (vtkSlicerTrackerStabilizerTrace::GetEnabled() == tracing)
+    {
+    return;
+    }
+  vtkSlicerTrackerStabilizerTrace::SetEnabled(tracing);
+  this->Modified();
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerTrackerStabilizerLogic
+::GetTracing()
+{
+  return vtkSlicerTrackerStabilizerTrace::GetEnabled();
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerTrackerStabilizerLogic
+::WriteTrace(const char* fileName)
+{
+  if (!vtkSlicerTrackerStabilizerTrace::WriteChromeTrace(fileName))
+    {
+    vtkErrorMacro("WriteTrace: cannot write " << (fileName ? fileName : "(null)"));
+    return false;
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::ClearTrace()
+{
+  vtkSlicerTrackerStabilizerTrace::Clear();
+}
+
+//-----------------------------------------------------------------------------
+double vtkSlicerTrackerStabilizerLogic
+::GetFilterMetric(vtkMRMLTrackerStabilizerNode* tsNode, int metric)
+{
+  if (metric < 0 || metric >= Metric_Last)
+    {
+    vtkErrorMacro("GetFilterMetric: Invalid metric " << metric);
+    return 0.0;
+    }
+  const FilterState* state = this->Internal->Find(tsNode);
+  return state ? ComputeMetric(state->Metrics, metric) : 0.0;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerTrackerStabilizerLogic
+::SweepFilterParameters(vtkDoubleArray* times, vtkDoubleArray* quaternions, vtkDoubleArray* positions,
+                        vtkDoubleArray* cutOffFrequencies, vtkIntArray* algorithms, vtkTable* results,
+                        vtkDoubleArray* groundTruthQuaternions, vtkDoubleArray* groundTruthPositions)
+{
+  if (times == NULL || quaternions == NULL || positions == NULL ||
+      cutOffFrequencies == NULL || algorithms == NULL || results == NULL)
+    {
+    vtkErrorMacro("SweepFilterParameters: Invalid input");
+    return false;
+    }
+  const vtkIdType numberOfSamples = times->GetNumberOfTuples();
+  if (!HasTuples(times, 1, numberOfSamples) ||
+      !HasTuples(quaternions, 4, numberOfSamples) || !HasTuples(positions, 3, numberOfSamples))
+    {
+    vtkErrorMacro("SweepFilterParameters: Expected one time, quaternion (4 components) "
+                  "and position (3 components) per sample");
+    return false;
+    }
+  const bool hasGroundTruth = (groundTruthQuaternions != NULL || groundTruthPositions != NULL);
+  if (hasGroundTruth &&
+      (!HasTuples(groundTruthQuaternions, 4, numberOfSamples) ||
+       !HasTuples(groundTruthPositions, 3, numberOfSamples)))
+    {
+    vtkErrorMacro("SweepFilterParameters: Ground truth must have one quaternion and one position per sample");
+    return false;
+    }
+
+  // Decode the stream once: contiguous, normalized quaternions in one hemisphere
+  SweepInput input;
+  input.NumberOfSamples = static_cast<size_t>(numberOfSamples);
+  input.Times.resize(input.NumberOfSamples);
+  input.Quaternions.resize(4*input.NumberOfSamples);
+  input.Positions.resize(3*input.NumberOfSamples);
+  for (vtkIdType i = 0; i < numberOfSamples; ++i)
+    {
+    input.Times[i] = times->GetValue(i);
+    double* quaternion = &input.Quaternions[4*i];
+    quaternions->GetTuple(i, quaternion);
+    NormalizeQuaternion(quaternion);
+    const double* previous = (i > 0) ? quaternion - 4 : quaternion;
+    if (quaternion[0]*previous[0] + quaternion[1]*previous[1] +
+        quaternion[2]*previous[2] + quaternion[3]*previous[3] < 0.0)
+      {
+      for (int c = 0; c < 4; ++c)
+        {
+        quaternion[c] = -quaternion[c];
+        }
+      }
+    positions->GetTuple(i, &input.Positions[3*i]);
+    }
+  std::vector<double> groundTruth;
+  input.HasGroundTruth = hasGroundTruth;
+  input.ReferenceQuaternions = input.Quaternions.empty() ? NULL : &input.Quaternions[0];
+  input.ReferencePositions = input.Positions.empty() ? NULL : &input.Positions[0];
+  if (hasGroundTruth && numberOfSamples > 0)
+    {
+    groundTruth.resize(7*input.NumberOfSamples);
+    double* truthQuaternions = &groundTruth[0];
+    double* truthPositions = &groundTruth[4*input.NumberOfSamples];
+    for (vtkIdType i = 0; i < numberOfSamples; ++i)
+      {
+      groundTruthQuaternions->GetTuple(i, truthQuaternions + 4*i);
+      NormalizeQuaternion(truthQuaternions + 4*i);
+      groundTruthPositions->GetTuple(i, truthPositions + 3*i);
+      }
+    input.ReferenceQuaternions = truthQuaternions;
+    input.ReferencePositions = truthPositions;
+    }
+  input.NumberOfSlerpTerms = (this->SlerpNumberOfTerms >= 0) ?
+    this->SlerpNumberOfTerms : Kernels::SelectNumberOfSlerpTerms(DefaultSweepSlerpTolerance);
+
+  // Grid of combinations, algorithms first
+  std::vector<int> combinationAlgorithms;
+  std::vector<double> combinationCutOffFrequencies;
+  for (vtkIdType a = 0; a < algorithms->GetNumberOfTuples(); ++a)
+    {
+    const int algorithm = algorithms->GetValue(a);
+    if (algorithm < PassThroughAlgorithm || algorithm >= Algorithm_Last)
+      {
+      vtkErrorMacro("SweepFilterParameters: Invalid algorithm " << algorithm);
+      return false;
+      }
+    for (vtkIdType f = 0; f < cutOffFrequencies->GetNumberOfTuples(); ++f)
+      {
+      combinationAlgorithms.push_back(algorithm);
+      combinationCutOffFrequencies.push_back(cutOffFrequencies->GetValue(f));
+      }
+    }
+
+  const vtkIdType numberOfCombinations = static_cast<vtkIdType>(combinationAlgorithms.size());
+  std::vector<FilterState::MetricSums> metrics(combinationAlgorithms.size());
+  SweepFunctor sweep(input, combinationAlgorithms, combinationCutOffFrequencies, metrics);
+  if (this->SweepInParallel && numberOfCombinations > 1)
+    {
+    vtkSMPTools::For(0, numberOfCombinations, 1, sweep);
+    }
+  else
+    {
+    sweep(0, numberOfCombinations);
+    }
+
+  vtkNew<vtkIntArray> algorithmColumn;
+  algorithmColumn->SetName("Algorithm");
+  vtkNew<vtkDoubleArray> cutOffFrequencyColumn;
+  cutOffFrequencyColumn->SetName("CutOffFrequency");
+  const int metricColumns[] =
+    { MetricLag, MetricResidualJitter, MetricPositionRMSError, MetricRotationRMSError };
+  const char* metricColumnNames[] =
+    { "Lag", "ResidualJitter", "PositionRMSError", "RotationRMSError" };
+  const int numberOfMetricColumns = 4;
+  vtkNew<vtkDoubleArray> metricColumn[numberOfMetricColumns];
+  for (int c = 0; c < numberOfMetricColumns; ++c)
+    {
+    metricColumn[c]->SetName(metricColumnNames[c]);
+    }
+  for (vtkIdType i = 0; i < numberOfCombinations; ++i)
+    {
+    algorithmColumn->InsertNextValue(combinationAlgorithms[i]);
+    cutOffFrequencyColumn->InsertNextValue(combinationCutOffFrequencies[i]);
+    for (int c = 0; c < numberOfMetricColumns; ++c)
+      {
+      metricColumn[c]->InsertNextValue(ComputeMetric(metrics[i], metricColumns[c]));
+      }
+    }
+
+  results->Initialize();
+  results->AddColumn(algorithmColumn.GetPointer());
+  results->AddColumn(cutOffFrequencyColumn.GetPointer());
+  for (int c = 0; c < numberOfMetricColumns; ++c)
+    {
+    results->AddColumn(metricColumn[c].GetPointer());
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerTrackerStabilizerLogic
+::FilterPoseSequence(vtkMRMLTrackerStabilizerNode* tsNode, vtkDoubleArray* times,
+                     vtkDoubleArray* quaternions, vtkDoubleArray* positions,
+                     vtkDoubleArray* filteredQuaternions, vtkDoubleArray* filteredPositions)
+{
+  if (tsNode == NULL || times == NULL)
+    {
+    vtkErrorMacro("FilterPoseSequence: Invalid input");
+    return false;
+    }
+  const vtkIdType numberOfSamples = times->GetNumberOfTuples();
+  if (!HasTuples(times, 1, numberOfSamples) ||
+      !HasTuples(quaternions, 4, numberOfSamples) || !HasTuples(positions, 3, numberOfSamples) ||
+      !HasTuples(filteredQuaternions, 4, numberOfSamples) ||
+      !HasTuples(filteredPositions, 3, numberOfSamples))
+    {
+    vtkErrorMacro("FilterPoseSequence: Expected one time, quaternion (4 components) "
+                  "and position (3 components) per sample, in the input and the output");
+    return false;
+    }
+  if (numberOfSamples == 0)
+    {
+    return true;
+    }
+
+  double cutOffFrequencies[4];
+  tsNode->GetEffectiveCutOffFrequencies(cutOffFrequencies);
+  const double toolFrame =
+    (tsNode->GetTranslationCutOffFrame() == vtkMRMLTrackerStabilizerNode::CutOffFrameTool) ? 1.0 : 0.0;
+  const size_t count = static_cast<size_t>(numberOfSamples);
+  const double* inputTimes = times->GetPointer(0);
+  const double* inputQuaternions = quaternions->GetPointer(0);
+  const double* inputPositions = positions->GetPointer(0);
+  double* outputQuaternions = filteredQuaternions->GetPointer(0);
+  double* outputPositions = filteredPositions->GetPointer(0);
+  switch (this->GetFilterAlgorithm(tsNode))
+    {
+    case Kernels::PassThroughAlgorithm:
+      FilterPoseArrays<Kernels::PassThroughFilter>(cutOffFrequencies, toolFrame, 0, count, inputTimes,
+        inputQuaternions, inputPositions, outputQuaternions, outputPositions);
+      break;
+    case Kernels::FastLowPassAlgorithm:
+      FilterPoseArrays<Kernels::FastLowPassFilter>(cutOffFrequencies, toolFrame, this->SlerpNumberOfTerms,
+        count, inputTimes, inputQuaternions, inputPositions, outputQuaternions, outputPositions);
+      break;
+    default:
+      FilterPoseArrays<Kernels::LowPassFilter>(cutOffFrequencies, toolFrame, 0, count, inputTimes,
+        inputQuaternions, inputPositions, outputQuaternions, outputPositions);
+      break;
+    }
+  filteredQuaternions->Modified();
+  filteredPositions->Modified();
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerTrackerStabilizerLogic
+::SmoothPoseSequence(vtkMRMLTrackerStabilizerNode* tsNode, int method, vtkDoubleArray* times,
+                     vtkDoubleArray* quaternions, vtkDoubleArray* positions,
+                     vtkDoubleArray* smoothedQuaternions, vtkDoubleArray* smoothedPositions)
+{
+  if (tsNode == NULL || times == NULL || method < ForwardBackwardSmoothing || method >= SmoothingMethod_Last)
+    {
+    vtkErrorMacro("SmoothPoseSequence: Invalid input");
+    return false;
+    }
+  const vtkIdType numberOfSamples = times->GetNumberOfTuples();
+  if (!HasTuples(times, 1, numberOfSamples) ||
+      !HasTuples(quaternions, 4, numberOfSamples) || !HasTuples(positions, 3, numberOfSamples) ||
+      !HasTuples(smoothedQuaternions, 4, numberOfSamples) ||
+      !HasTuples(smoothedPositions, 3, numberOfSamples) ||
+      smoothedQuaternions == quaternions || smoothedPositions == positions)
+    {
+    vtkErrorMacro("SmoothPoseSequence: Expected one time, quaternion (4 components) "
+                  "and position (3 components) per sample, in separate input and output arrays");
+    return false;
+    }
+  if (numberOfSamples == 0)
+    {
+    return true;
+    }
+
+  double cutOffFrequencies[4];
+  tsNode->GetEffectiveCutOffFrequencies(cutOffFrequencies);
+  const double toolFrame =
+    (tsNode->GetTranslationCutOffFrame() == vtkMRMLTrackerStabilizerNode::CutOffFrameTool) ? 1.0 : 0.0;
+  const size_t count = static_cast<size_t>(numberOfSamples);
+  const double* inputTimes = times->GetPointer(0);
+  const double* inputQuaternions = quaternions->GetPointer(0);
+  const double* inputPositions = positions->GetPointer(0);
+  double* outputQuaternions = smoothedQuaternions->GetPointer(0);
+  double* outputPositions = smoothedPositions->GetPointer(0);
+
+  // Overlap in samples, from the slowest cutoff frequency (the time
+  // constant of the filter is 1/cutoff) and the mean time step. A zero or
+  // very low cutoff would need the whole sequence as overlap: the overlap is
+  // clamped so memory stays bounded, and the chunk boundaries are then only
+  // approximately smooth.
+  const double duration = inputTimes[count - 1] - inputTimes[0];
+  const double timeStep = (count > 1 && duration > 0.0) ? duration / (count - 1) : FilterTimeStep;
+  double minimumCutOffFrequency = VTK_DOUBLE_MAX;
+  for (int i = 0; i < 4; ++i)
+    {
+    minimumCutOffFrequency = std::min(minimumCutOffFrequency, cutOffFrequencies[i]);
+    }
+  const double requiredOverlap = (minimumCutOffFrequency > 0.0) ?
+    ceil(SmoothingOverlapTimeConstants / (minimumCutOffFrequency*timeStep)) : VTK_DOUBLE_MAX;
+  size_t overlap = MaximumSmoothingOverlap;
+  if (requiredOverlap < static_cast<double>(MaximumSmoothingOverlap))
+    {
+    overlap = static_cast<size_t>(requiredOverlap);
+    }
+  else if (count > SequenceChunkSize)
+    {
+    vtkWarningMacro("SmoothPoseSequence: Cutoff frequency " << minimumCutOffFrequency
+                    << " Hz is too low for the chunk overlap, the sequence is smoothed"
+                    " in chunks overlapping by " << MaximumSmoothingOverlap << " samples");
+    }
+  overlap = std::min(count, overlap);
+
+  std::vector<double> windowQuaternions;
+  std::vector<double> windowPositions;
+  std::vector<double> windowGains;
+  for (size_t begin = 0; begin < count; begin += SequenceChunkSize)
+    {
+    const size_t end = std::min(count, begin + SequenceChunkSize);
+    const size_t windowBegin = (begin > overlap) ? begin - overlap : 0;
+    const size_t windowEnd = std::min(count, end + overlap);
+    const size_t windowSize = windowEnd - windowBegin;
+    windowQuaternions.assign(inputQuaternions + 4*windowBegin, inputQuaternions + 4*windowEnd);
+    windowPositions.assign(inputPositions + 3*windowBegin, inputPositions + 3*windowEnd);
+    windowGains.resize(4*windowSize);
+    for (size_t i = 0; i < windowSize; ++i)
+      {
+      NormalizeQuaternion(&windowQuaternions[4*i]);
+      }
+
+    Kernels::SmoothSequence(method, windowSize, inputTimes + windowBegin, cutOffFrequencies, toolFrame,
+                            FilterTimeStep, &windowQuaternions[0], &windowPositions[0], &windowGains[0]);
+
+    const size_t offset = begin - windowBegin;
+    std::copy(windowQuaternions.begin() + 4*offset, windowQuaternions.begin() + 4*(offset + end - begin),
+              outputQuaternions + 4*begin);
+    std::copy(windowPositions.begin() + 3*offset, windowPositions.begin() + 3*(offset + end - begin),
+              outputPositions + 3*begin);
+    }
+  smoothedQuaternions->Modified();
+  smoothedPositions->Modified();
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::ResetFilterMetrics(vtkMRMLTrackerStabilizerNode* tsNode)
+{
+  vtkInternal::FilterStateVector& activeFilters = this->Internal->ActiveFilters;
+  for (size_t i = 0; i < activeFilters.size(); ++i)
+    {
+    if (tsNode == NULL || activeFilters[i].Node == tsNode)
+      {
+      activeFilters[i].Metrics.Reset();
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerTrackerStabilizerLogic
+::StartSharedMemoryOutput(const char* segmentName, int maximumNumberOfTools, int ringSize)
+{
+  // Tools are assigned a slot again on their next output
+  vtkInternal::FilterStateVector& activeFilters = this->Internal->ActiveFilters;
+  for (size_t i = 0; i < activeFilters.size(); ++i)
+    {
+    activeFilters[i].SharedMemoryTool = -1;
+    }
+
+  if (maximumNumberOfTools <= 0 || ringSize <= 0 ||
+      !this->Internal->SharedMemoryWriter.Create(segmentName,
+        static_cast<unsigned int>(maximumNumberOfTools), static_cast<unsigned int>(ringSize)))
+    {
+    vtkErrorMacro("StartSharedMemoryOutput: Failed to create shared memory segment "
+                  << (segmentName ? segmentName : "(null)"));
+    return false;
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::StopSharedMemoryOutput()
+{
+  this->Internal->SharedMemoryWriter.Close();
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerTrackerStabilizerLogic
+::GetSharedMemoryOutputActive()
+{
+  return this->Internal->SharedMemoryWriter.IsOpen();
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerTrackerStabilizerLogic
+::StartNetworkOutput(const char* host, int port, int protocol)
+{
+  vtkInternal::FilterStateVector& activeFilters = this->Internal->ActiveFilters;
+  for (size_t i = 0; i < activeFilters.size(); ++i)
+    {
+    activeFilters[i].NetworkTool = -1;
+    }
+
+  const int senderProtocol = (protocol == NetworkTCP) ?
+    TrackerStabilizerNetworkSender::TCP : TrackerStabilizerNetworkSender::UDP;
+  if (!this->Internal->NetworkSender.Open(senderProtocol, host, port))
+    {
+    vtkErrorMacro("StartNetworkOutput: Failed to connect to "
+                  << (host ? host : "(null)") << ":" << port);
+    return false;
+    }
+  this->Internal->NetworkLastSendTime = 0.0;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::StopNetworkOutput()
+{
+  this->Internal->NetworkSender.Close();
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerTrackerStabilizerLogic
+::GetNetworkOutputActive()
+{
+  return this->Internal->NetworkSender.IsOpen();
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::SendNetworkFrame(double time)
+{
+  TrackerStabilizerNetworkSender& sender = this->Internal->NetworkSender;
+  sender.BeginFrame(time);
+
+  vtkInternal::FilterStateVector& activeFilters = this->Internal->ActiveFilters;
+  for (size_t i = 0; i < activeFilters.size(); ++i)
+    {
+    FilterState& state = activeFilters[i];
+    if (!state.Valid)
+      {
+      continue;
+      }
+    // A renamed or other output node is sent as another tool
+    vtkMRMLLinearTransformNode* outputNode = state.Node->GetFilteredTransformNode();
+    const char* toolName = (outputNode && outputNode->GetName()) ?
+      outputNode->GetName() : state.NodeID.c_str();
+    if (state.NetworkTool < 0 || state.NetworkToolName != toolName)
+      {
+      state.NetworkTool = sender.FindOrAddTool(toolName);
+      state.NetworkToolName = toolName;
+      }
+
+    if (state.ReferenceNode == NULL)
+      {
+      sender.AddPose(state.NetworkTool, state.Quaternion, state.Position);
+      }
+    else
+      {
+      double quaternion[4];
+      double position[3];
+      MatrixToPose(state.OutputMatrix, quaternion, position);
+      sender.AddPose(state.NetworkTool, quaternion, position);
+      }
+    }
+
+  if (!sender.SendFrame() && !sender.IsOpen())
+    {
+    vtkWarningMacro("SendNetworkFrame: Connection lost, network output stopped");
+    }
+  this->Internal->NetworkLastSendTime = time;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::UpdateMotionState(vtkMRMLTrackerStabilizerNode* tsNode, FilterState& state, double dt)
+{
+  const double now = state.SampleTime;
+  double position[3];
+  double rotation[3][3];
+  for (int i = 0; i < 3; i++)
+    {
+    position[i] = state.InputMatrix[i][3];
+    rotation[i][0] = state.InputMatrix[i][0];
+    rotation[i][1] = state.InputMatrix[i][1];
+    rotation[i][2] = state.InputMatrix[i][2];
+    }
+  double quaternion[4];
+  vtkMath::Matrix3x3ToQuaternion(rotation, quaternion);
+
+  if (!state.MotionInitialized)
+    {
+    state.MotionInitialized = true;
+    state.TranslationSpeed = 0.0;
+    state.RotationSpeed = 0.0;
+    for (int i = 0; i < 4; i++)
+      {
+      state.BlendFactors[i] = state.StationaryBlendFactors[i];
+      }
+    state.MotionState = vtkMRMLTrackerStabilizerNode::MotionStationary;
+    }
+  else
+    {
+    const double elapsed = std::max(now - state.LastTime, 1e-3);
+
+    // Incremental velocity estimates, averaged over a few samples so that a
+    // single jitter spike does not switch the state
+    const double speedSmoothing = 0.5;
+    const double translationSpeed =
+      sqrt(vtkMath::Distance2BetweenPoints(position, state.LastPosition)) / elapsed;
+    const double cosHalfAngle = std::min(1.0, fabs(
+      quaternion[0]*state.LastQuaternion[0] + quaternion[1]*state.LastQuaternion[1] +
+      quaternion[2]*state.LastQuaternion[2] + quaternion[3]*state.LastQuaternion[3]));
+    const double rotationSpeed = vtkMath::DegreesFromRadians(2.0*acos(cosHalfAngle)) / elapsed;
+    state.TranslationSpeed += speedSmoothing*(translationSpeed - state.TranslationSpeed);
+    state.RotationSpeed += speedSmoothing*(rotationSpeed - state.RotationSpeed);
+
+    const int currentState = state.MotionState;
+    const double hysteresis = tsNode->GetMotionHysteresis();
+    state.MotionState = std::max(
+      ClassifySpeed(currentState, state.TranslationSpeed,
+                    tsNode->GetSlowTranslationSpeed(), tsNode->GetFastTranslationSpeed(), hysteresis),
+      ClassifySpeed(currentState, state.RotationSpeed,
+                    tsNode->GetSlowRotationSpeed(), tsNode->GetFastRotationSpeed(), hysteresis));
+
+    // Move smoothly towards the filter strength of the new state
+    const double transitionTime = tsNode->GetMotionTransitionTime();
+    const double transition = (transitionTime > 0.0) ? elapsed/(transitionTime + elapsed) : 1.0;
+    for (int i = 0; i < 4; i++)
+      {
+      double targetBlendFactor = state.StationaryBlendFactors[i];
+      if (state.MotionState == vtkMRMLTrackerStabilizerNode::MotionSlow)
+        {
+        targetBlendFactor = Kernels::BlendFactorFromCutOffFrequency(
+          state.CutOffFrequencies[i]*tsNode->GetSlowCutOffFrequencyScale(), dt);
+        }
+      else if (state.MotionState == vtkMRMLTrackerStabilizerNode::MotionFast)
+        {
+        targetBlendFactor = 1.0; // Pass through
+        }
+      state.BlendFactors[i] += transition*(targetBlendFactor - state.BlendFactors[i]);
+      }
+    }
+
+  state.LastTime = now;
+  for (int i = 0; i < 3; i++)
+    {
+    state.LastPosition[i] = position[i];
+    }
+  for (int i = 0; i < 4; i++)
+    {
+    state.LastQuaternion[i] = quaternion[i];
+    }
+}
+
+//-----------------------------------------------------------------------------
+template <class Algorithm>
+void vtkSlicerTrackerStabilizerLogic::vtkInternal::FilterSequenceJob(SequenceJob& job)
+{
+  vtkTrackerStabilizerTraceMacro("FilterSequence", NULL);
+  Kernels::SequenceFilter<double, Algorithm> filter;
+  filter.Configure(job.CutOffFrequencies, job.ToolFrame, job.NumberOfSlerpTerms, FilterTimeStep);
+  const size_t numberOfSamples = job.Times.size();
+  for (size_t begin = 0; begin < numberOfSamples; begin += SequenceChunkSize)
+    {
+    if (job.Cancel.load(std::memory_order_relaxed))
+      {
+      return;
+      }
+    const size_t count = std::min(SequenceChunkSize, numberOfSamples - begin);
+    double* quaternions = &job.Quaternions[4*begin];
+    double* positions = &job.Positions[3*begin];
+    Kernels::FilterSequence(filter, count, &job.Times[begin], quaternions, positions,
+                            quaternions, positions);
+    job.Progress.store(begin + count, std::memory_order_relaxed);
+    }
+}
+
+//-----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkSlicerTrackerStabilizerLogic::vtkInternal::FilterSequenceThread(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  SequenceJob& job = *static_cast<SequenceJob*>(info->UserData);
+  switch (job.Algorithm)
+    {
+    case Kernels::PassThroughAlgorithm:
+      FilterSequenceJob<Kernels::PassThroughFilter>(job);
+      break;
+    case Kernels::FastLowPassAlgorithm:
+      FilterSequenceJob<Kernels::FastLowPassFilter>(job);
+      break;
+    default:
+      FilterSequenceJob<Kernels::LowPassFilter>(job);
+      break;
+    }
+  // Filtered arrays are visible to the main thread once Done is seen
+  job.Done.store(1, std::memory_order_release);
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerTrackerStabilizerLogic
+::StartSequenceFiltering(vtkMRMLTrackerStabilizerNode* tsNode,
+                         vtkMRMLNode* inputSequenceNode, vtkMRMLNode* outputSequenceNode)
+{
+#ifdef TrackerStabilizer_USE_SEQUENCES
+  vtkInternal::SequenceJob& job = this->Internal->Sequence;
+  if (job.ThreadID >= 0)
+    {
+    vtkErrorMacro("StartSequenceFiltering: A sequence is already being filtered");
+    return false;
+    }
+  vtkMRMLSequenceNode* inputSequence = vtkMRMLSequenceNode::SafeDownCast(inputSequenceNode);
+  vtkMRMLSequenceNode* outputSequence = vtkMRMLSequenceNode::SafeDownCast(outputSequenceNode);
+  if (tsNode == NULL || inputSequence == NULL || outputSequence == NULL || inputSequence == outputSequence)
+    {
+    vtkErrorMacro("StartSequenceFiltering: Invalid filter node or sequence nodes");
+    return false;
+    }
+  if (inputSequence->GetIndexType() != vtkMRMLSequenceNode::NumericIndex)
+    {
+    vtkErrorMacro("StartSequenceFiltering: The input sequence must have a numeric (time) index");
+    return false;
+    }
+
+  // Read all the items once, through the transfer matrix
+  const int numberOfItems = inputSequence->GetNumberOfDataNodes();
+  const double timeScale = (inputSequence->GetIndexUnit() == "ms") ? 1e-3 : 1.0;
+  job.Times.resize(numberOfItems);
+  job.Quaternions.resize(4*numberOfItems);
+  job.Positions.resize(3*numberOfItems);
+  job.IndexValues.resize(numberOfItems);
+  vtkMatrix4x4* matrix = this->Internal->TransferMatrix;
+  for (int i = 0; i < numberOfItems; ++i)
+    {
+    vtkMRMLLinearTransformNode* transformNode =
+      vtkMRMLLinearTransformNode::SafeDownCast(inputSequence->GetNthDataNode(i));
+    if (transformNode == NULL)
+      {
+      vtkErrorMacro("StartSequenceFiltering: Item " << i << " of the input sequence is not a linear transform");
+      job.Times.clear();
+      job.Quaternions.clear();
+      job.Positions.clear();
+      job.IndexValues.clear();
+      return false;
+      }
+    job.IndexValues[i] = inputSequence->GetNthIndexValue(i);
+    job.Times[i] = timeScale*strtod(job.IndexValues[i].c_str(), NULL);
+    transformNode->GetMatrixTransformToParent(matrix);
+    double element[4][4];
+    memcpy(element, matrix->Element, sizeof(element));
+    MatrixToPose(element, &job.Quaternions[4*i], &job.Positions[3*i]);
+    }
+
+  tsNode->GetEffectiveCutOffFrequencies(job.CutOffFrequencies);
+  job.ToolFrame =
+    (tsNode->GetTranslationCutOffFrame() == vtkMRMLTrackerStabilizerNode::CutOffFrameTool) ? 1.0 : 0.0;
+  job.Algorithm = this->GetFilterAlgorithm(tsNode);
+  job.NumberOfSlerpTerms = std::max(this->SlerpNumberOfTerms, 0);
+  job.InputSequenceNode = inputSequence;
+  job.OutputSequenceNode = outputSequence;
+  job.Progress = 0;
+  job.Cancel = 0;
+  job.Done = 0;
+  job.ThreadID = this->Internal->SequenceThreader->SpawnThread(
+    &vtkInternal::FilterSequenceThread, &job);
+  if (job.ThreadID < 0)
+    {
+    vtkErrorMacro("StartSequenceFiltering: Failed to start the filtering thread");
+    return false;
+    }
+  this->InvokeEvent(vtkCommand::StartEvent);
+  return true;
+#else
+  (void)tsNode;
+  (void)inputSequenceNode;
+  (void)outputSequenceNode;
+  vtkErrorMacro("StartSequenceFiltering: Built without the Sequences module");
+  return false;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerTrackerStabilizerLogic
+::UpdateSequenceFiltering(bool wait)
+{
+  vtkInternal::SequenceJob& job = this->Internal->Sequence;
+  if (job.ThreadID < 0)
+    {
+    return true;
+    }
+  if (!wait && !job.Done.load(std::memory_order_acquire))
+    {
+    double progress = this->GetSequenceFilteringProgress();
+    this->InvokeEvent(vtkCommand::ProgressEvent, &progress);
+    return false;
+    }
+  this->Internal->SequenceThreader->TerminateThread(job.ThreadID);
+  job.ThreadID = -1;
+
+#ifdef TrackerStabilizer_USE_SEQUENCES
+  vtkMRMLSequenceNode* inputSequence = vtkMRMLSequenceNode::SafeDownCast(job.InputSequenceNode);
+  vtkMRMLSequenceNode* outputSequence = vtkMRMLSequenceNode::SafeDownCast(job.OutputSequenceNode);
+  if (outputSequence && !job.Cancel)
+    {
+    // The sequence copies the item, so one node and one matrix are reused
+    const int wasModifying = outputSequence->StartModify();
+    outputSequence->RemoveAllDataNodes();
+    if (inputSequence)
+      {
+      outputSequence->SetIndexName(inputSequence->GetIndexName());
+      outputSequence->SetIndexUnit(inputSequence->GetIndexUnit());
+      outputSequence->SetIndexType(inputSequence->GetIndexType());
+      }
+    vtkNew<vtkMRMLLinearTransformNode> transformNode;
+    vtkMatrix4x4* matrix = this->Internal->TransferMatrix;
+    for (size_t i = 0; i < job.IndexValues.size(); ++i)
+      {
+      double element[4][4];
+      PoseToMatrix(&job.Quaternions[4*i], &job.Positions[3*i], element);
+      memcpy(matrix->Element, element, sizeof(element));
+      matrix->Modified();
+      transformNode->SetMatrixTransformToParent(matrix);
+      outputSequence->SetDataNodeAtValue(transformNode.GetPointer(), job.IndexValues[i]);
+      }
+    outputSequence->EndModify(wasModifying);
+    }
+#endif
+
+  job.Times.clear();
+  job.Quaternions.clear();
+  job.Positions.clear();
+  job.IndexValues.clear();
+  job.InputSequenceNode = NULL;
+  job.OutputSequenceNode = NULL;
+  this->InvokeEvent(vtkCommand::EndEvent);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerLogic
+::CancelSequenceFiltering()
+{
+  vtkInternal::SequenceJob& job = this->Internal->Sequence;
+  if (job.ThreadID < 0)
+    {
+    return;
+    }
+  job.Cancel.store(1, std::memory_order_relaxed);
+  this->UpdateSequenceFiltering(true);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerTrackerStabilizerLogic
+::GetSequenceFilteringActive()
+{
+  return this->Internal->Sequence.ThreadID >= 0;
+}
+
+//-----------------------------------------------------------------------------
+double vtkSlicerTrackerStabilizerLogic
+::GetSequenceFilteringProgress()
+{
+  vtkInternal::SequenceJob& job = this->Internal->Sequence;
+  if (job.ThreadID < 0 || job.Times.empty())
+    {
+    return 1.0;
+    }
+  return static_cast<double>(job.Progress.load(std::memory_order_relaxed)) / job.Times.size();
+}
+
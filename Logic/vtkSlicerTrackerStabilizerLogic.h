@@ -42,7 +42,10 @@
 
 #include "vtkSlicerTrackerStabilizerModuleLogicExport.h"
 
+class vtkDoubleArray;
+class vtkIntArray;
 class vtkMatrix4x4;
+class vtkTable;
 
 /// \ingroup Slicer_QtModules_ExtensionTemplate
 class VTK_SLICER_TRACKERSTABILIZER_MODULE_LOGIC_EXPORT vtkSlicerTrackerStabilizerLogic :
@@ -58,6 +61,240 @@ public:
 
   void Filter(vtkMRMLTrackerStabilizerNode* tsNode);
 
+  /// Filter all nodes of the scene that have both an input and an output.
+  /// The set of these nodes is maintained from scene and node events, so the
+  /// cost only depends on the number of active filters.
+  void FilterActiveNodes();
+  int GetNumberOfActiveFilters();
+
+  /// Time (s) after the start of FilterActiveNodes by which the outputs
+  /// should be published. Nodes are served by decreasing priority (see
+  /// vtkMRMLTrackerStabilizerNode::Priority); once the deadline has passed,
+  /// the outputs of nodes below the highest priority are postponed (shed):
+  /// they are written to the shared memory output right away, and published
+  /// to MRML at a later call unless a new sample of the node supersedes
+  /// them. 0 (default) never postpones updates.
+  vtkSetMacro(FilterDeadline, double);
+  vtkGetMacro(FilterDeadline, double);
+
+  /// Updates of an active node, or of all active nodes if NULL, that were
+  /// published after the deadline or shed
+  vtkTypeInt64 GetNumberOfMissedDeadlines(vtkMRMLTrackerStabilizerNode* tsNode = NULL);
+
+  /// Updates of an active node, or of all active nodes if NULL, that were shed
+  vtkTypeInt64 GetNumberOfShedUpdates(vtkMRMLTrackerStabilizerNode* tsNode = NULL);
+
+  /// Reset the counters of a node, or of all nodes if NULL
+  void ResetSchedulingCounters(vtkMRMLTrackerStabilizerNode* tsNode = NULL);
+
+  /// Number of threads used by FilterActiveNodes to compute the filters.
+  /// 1 (default) filters serially, 0 uses all available cores.
+  void SetNumberOfThreads(int numberOfThreads);
+  vtkGetMacro(NumberOfThreads, int);
+
+  /// Compute the low-pass filters of FilterActiveNodes in one single
+  /// precision batch instead of one double precision step per node.
+  /// Filters of a group (see vtkMRMLTrackerStabilizerNode::GroupID) are
+  /// still computed in double precision. Off by default: the batch is only
+  /// about 4% faster, it renormalizes the quaternions at every step and its
+  /// outputs differ from double by up to 2e-6 (quaternion) and 1e-4 mm.
+  /// It is kept as an opt-in to measure that trade-off with other compilers
+  /// and targets, where the batch loop may vectorize.
+  vtkSetMacro(SinglePrecision, bool);
+  vtkGetMacro(SinglePrecision, bool);
+  vtkBooleanMacro(SinglePrecision, bool);
+
+  /// Maximum distance between the quaternions interpolated by the low-pass
+  /// filters and the exact slerp. When not 0, a polynomial slerp without
+  /// trigonometric functions is used, with the smallest number of terms that
+  /// was checked to meet the tolerance for any blend factor and angle
+  /// (see GetSlerpNumberOfTerms). 0 (default) always uses Slerp.
+  void SetSlerpTolerance(double tolerance);
+  vtkGetMacro(SlerpTolerance, double);
+
+  /// Number of terms of the polynomial slerp, 0 for nlerp, -1 if Slerp is used
+  vtkGetMacro(SlerpNumberOfTerms, int);
+
+  /// Also publish the filtered poses to a POSIX shared memory segment, for
+  /// processes running outside Slicer. Each tool is identified by the name of
+  /// its filtered transform node. See TrackerStabilizerSharedMemory.h for the
+  /// layout and the reader.
+  bool StartSharedMemoryOutput(const char* segmentName,
+                               int maximumNumberOfTools = 64, int ringSize = 256);
+  void StopSharedMemoryOutput();
+  bool GetSharedMemoryOutputActive();
+
+  enum NetworkProtocols
+  {
+    NetworkUDP = 0,
+    NetworkTCP
+  };
+
+  /// Also stream the filtered poses to a receiver over UDP or TCP. All the
+  /// tools filtered by one FilterActiveNodes call are sent in one frame. See
+  /// TrackerStabilizerNetwork.h for the frame format and the receiver.
+  bool StartNetworkOutput(const char* host, int port, int protocol = NetworkUDP);
+  void StopNetworkOutput();
+  bool GetNetworkOutputActive();
+
+  /// Maximum number of frames sent per second. 0 (default) sends every tick.
+  vtkSetMacro(NetworkMaximumSendRate, double);
+  vtkGetMacro(NetworkMaximumSendRate, double);
+
+  enum FilterMetrics
+  {
+    MetricNumberOfSamples = 0, // Samples compared with the ground truth
+    MetricPositionRMSError,    // mm
+    MetricRotationRMSError,    // deg
+    MetricLag,                 // s, output behind the ground truth
+    MetricResidualJitter,      // mm, RMS of the high-frequency position error
+    Metric_Last
+  };
+
+  /// Accuracy of the filtered output against the ground truth transform node
+  /// of the filter node (see vtkMRMLTrackerStabilizerNode), accumulated over
+  /// all samples filtered by FilterActiveNodes since the ground truth node
+  /// was set or the metrics were reset. The lag is the maximum of the
+  /// cross-correlation of the output and ground truth velocities. Returns 0
+  /// for nodes without samples.
+  double GetFilterMetric(vtkMRMLTrackerStabilizerNode* tsNode, int metric);
+
+  /// Reset the metrics of a node, or of all nodes if NULL
+  void ResetFilterMetrics(vtkMRMLTrackerStabilizerNode* tsNode = NULL);
+
+  /// Record trace points of the event receipt, input gathering, computation
+  /// and publishing of each filter, for all logics of the process. Off by
+  /// default. See vtkSlicerTrackerStabilizerTrace.
+  void SetTracing(bool tracing);
+  bool GetTracing();
+
+  /// Write the recorded trace points as Chrome trace-event JSON, or forget them
+  bool WriteTrace(const char* fileName);
+  void ClearTrace();
+
+  /// Components of a diagnostics snapshot
+  enum DiagnosticsComponents
+  {
+    DiagnosticsTime = 0,        // s
+    DiagnosticsInputPositionX,  // mm, relative to the reference if any
+    DiagnosticsInputPositionY,
+    DiagnosticsInputPositionZ,
+    DiagnosticsOutputPositionX,
+    DiagnosticsOutputPositionY,
+    DiagnosticsOutputPositionZ,
+    DiagnosticsInputAngle,      // deg, rotation angle of the pose
+    DiagnosticsOutputAngle,
+    DiagnosticsUpdateRate,      // samples per second since the previous snapshot
+    DiagnosticsProcessingTime,  // s, mean filter computation time per sample
+    Diagnostics_Last
+  };
+
+  /// Number of diagnostics snapshots recorded per second for each node, for
+  /// display. 0 (default) records nothing and does not time the filters.
+  void SetDiagnosticsRate(double rate);
+  vtkGetMacro(DiagnosticsRate, double);
+
+  /// Copy the last diagnostics snapshots of a node (up to 600, oldest
+  /// first) to snapshots, one tuple of Diagnostics_Last components each.
+  /// Does not lock the filtering. Returns the number of snapshots.
+  int GetDiagnostics(vtkMRMLTrackerStabilizerNode* tsNode, vtkDoubleArray* snapshots);
+
+  /// Filter algorithms, same values as vtkSlicerTrackerStabilizerFilterKernels
+  enum FilterAlgorithms
+  {
+    PassThroughAlgorithm = 0,
+    LowPassAlgorithm,
+    FastLowPassAlgorithm,
+    Algorithm_Last
+  };
+
+  /// Filter a recorded pose stream of one tool with every combination of
+  /// algorithm and cutoff frequency (Hz, used for the rotation and all
+  /// translation axes), and replace the content of results with one row per
+  /// combination: Algorithm, CutOffFrequency, Lag (s), ResidualJitter (mm),
+  /// PositionRMSError (mm) and RotationRMSError (deg).
+  /// times (s) has one component, quaternions four (w, x, y, z) and
+  /// positions three. Without ground truth, the errors and the lag are
+  /// measured against the input and the jitter is that of the output.
+  /// The fast low-pass filter uses the number of terms of SlerpTolerance, or
+  /// of a 1e-6 tolerance if it is 0. The input is read once and shared by
+  /// all combinations, which are filtered in parallel (see SweepInParallel).
+  bool SweepFilterParameters(vtkDoubleArray* times, vtkDoubleArray* quaternions,
+                             vtkDoubleArray* positions,
+                             vtkDoubleArray* cutOffFrequencies, vtkIntArray* algorithms,
+                             vtkTable* results,
+                             vtkDoubleArray* groundTruthQuaternions = NULL,
+                             vtkDoubleArray* groundTruthPositions = NULL);
+
+  /// Filter the combinations of SweepFilterParameters on all the threads
+  /// of vtkSMPTools, which are all the cores unless SetNumberOfThreads
+  /// limited them. Unlike the per-tick filtering, sweeps are offline work,
+  /// so this is on by default.
+  vtkSetMacro(SweepInParallel, bool);
+  vtkGetMacro(SweepInParallel, bool);
+  vtkBooleanMacro(SweepInParallel, bool);
+
+  /// Filter a whole recorded pose sequence with the parameters of a filter
+  /// node, without going through MRML: times (s, one component), unit
+  /// quaternions (w, x, y, z) and positions. The filtered poses are written
+  /// to filteredQuaternions and filteredPositions, which must already have
+  /// as many tuples as the input and may be the input arrays. The arrays are
+  /// accessed in place, so NumPy arrays wrapped with
+  /// vtk.util.numpy_support.numpy_to_vtk are not copied.
+  /// The weights of each sample are computed from its time step; motion
+  /// detection and tool tip tuning are not applied, and the node filter
+  /// state is not modified.
+  bool FilterPoseSequence(vtkMRMLTrackerStabilizerNode* tsNode, vtkDoubleArray* times,
+                          vtkDoubleArray* quaternions, vtkDoubleArray* positions,
+                          vtkDoubleArray* filteredQuaternions, vtkDoubleArray* filteredPositions);
+
+  /// Offline smoothing methods, same values as vtkSlicerTrackerStabilizerFilterKernels
+  enum SmoothingMethods
+  {
+    ForwardBackwardSmoothing = 0, // Low-pass filter forward then backward, zero phase
+    RauchTungStriebelSmoothing,   // Kalman filter forward, RTS smoother backward
+    SmoothingMethod_Last
+  };
+
+  /// Smooth a whole recorded pose sequence without causality, so that the
+  /// smoothed poses do not lag behind the input. The arrays are those of
+  /// FilterPoseSequence, except that the output arrays must not be the input
+  /// ones. The cutoff frequencies of the node set the strength of both
+  /// methods: the forward-backward filter applies the low-pass filter twice,
+  /// and the process noise of the Kalman filter (a local level model, as
+  /// there is no motion model) is chosen so that its steady state gain is the
+  /// low-pass weight. The sequence is processed in chunks overlapping by a
+  /// few time constants of the filter, so the working memory does not depend
+  /// on the length of the sequence. The overlap is capped for very low or
+  /// zero cutoff frequencies, with a warning.
+  bool SmoothPoseSequence(vtkMRMLTrackerStabilizerNode* tsNode, int method, vtkDoubleArray* times,
+                          vtkDoubleArray* quaternions, vtkDoubleArray* positions,
+                          vtkDoubleArray* smoothedQuaternions, vtkDoubleArray* smoothedPositions);
+
+  /// Filter a sequence of linear transforms (vtkMRMLSequenceNode with a
+  /// time index, in s or ms) into another sequence, with the parameters of
+  /// a filter node as in FilterPoseSequence. The input is read when called,
+  /// then filtered by a background thread; call UpdateSequenceFiltering from
+  /// the main thread (e.g. from a timer) to get ProgressEvent and to write
+  /// the output sequence when done (EndEvent). One sequence at a time.
+  /// Only available when built with the Sequences module.
+  bool StartSequenceFiltering(vtkMRMLTrackerStabilizerNode* tsNode,
+                              vtkMRMLNode* inputSequenceNode, vtkMRMLNode* outputSequenceNode);
+
+  /// Write the output sequence if the background filtering is done, or wait
+  /// for it. Returns true when there is no filtering in progress anymore.
+  bool UpdateSequenceFiltering(bool wait = false);
+
+  /// Stop the background filtering, the output sequence is not modified
+  void CancelSequenceFiltering();
+
+  bool GetSequenceFilteringActive();
+
+  /// Fraction of the samples of the sequence filtered so far
+  double GetSequenceFilteringProgress();
+
+  struct FilterState;
+
 protected:
   vtkSlicerTrackerStabilizerLogic();
   virtual ~vtkSlicerTrackerStabilizerLogic();
@@ -74,7 +311,76 @@ protected:
 				double itemAweight, double itemBweight,
 				vtkMatrix4x4* interpolatedMatrix);
 
+  void InterpolateTransform(const double itemAmatrix[4][4], const double itemBmatrix[4][4],
+                            double itemAweight, double itemBweight,
+                            double interpolatedMatrix[4][4]);
+
+  /// Filtering steps. Gathering and publishing access MRML and must run on
+  /// the main thread; computing only reads node parameters and may run from
+  /// any thread.
+  bool GatherFilterInput(FilterState& state, double time);
+  void ComputeFilter(FilterState& state);
+  void PublishFilterOutput(FilterState& state);
+
+  /// Publish the output unless the deadline has passed and the node is not
+  /// of the highest priority, and count missed deadlines. A shed output is
+  /// written to shared memory and kept pending.
+  void PublishScheduledFilterOutput(FilterState& state, double deadline, int highestPriority);
+
+  /// Publish the computed and pending outputs of the active filters, by
+  /// decreasing priority
+  void PublishScheduledFilterOutputs(double deadline, int highestPriority);
+
+  /// Write the output pose to the shared memory output, if started
+  void WriteSharedMemoryOutput(FilterState& state);
+
+  /// Select the filter specialization from the node parameters, once per
+  /// parameter change rather than for every sample
+  void ConfigureFilter(FilterState& state);
+
+  /// Algorithm used for the node with the current logic settings
+  int GetFilterAlgorithm(vtkMRMLTrackerStabilizerNode* tsNode);
+
+  /// Filter the common motion of each group of filters (see
+  /// vtkMRMLTrackerStabilizerNode::GroupID) once, and hand it to the members
+  /// gathered for this tick
+  void UpdateFilterGroups();
+
+  /// Compute all gathered filters, low-pass ones in a single precision batch.
+  /// With diagnostics, the batch time is shared equally by the batched nodes
+  /// and the other nodes are timed individually.
+  void ComputeFiltersInSinglePrecision();
+
+  /// Add or remove the node from the active set depending on its references
+  void UpdateActiveFilter(vtkMRMLTrackerStabilizerNode* tsNode);
+  void RemoveActiveFilter(vtkMRMLTrackerStabilizerNode* tsNode);
+
+  /// Update the motion state of the node from the new input sample and the
+  /// weights of the input sample to use in the low-pass filter (one for the
+  /// rotation and one per translation axis, see FilterState::BlendFactors).
+  void UpdateMotionState(vtkMRMLTrackerStabilizerNode* tsNode, FilterState& state, double dt);
+
+  /// Compare the output with the ground truth, if any, on the main thread
+  void UpdateFilterMetrics(FilterState& state);
+
+  /// Record a diagnostics snapshot of the node if it is time to
+  void UpdateDiagnostics(FilterState& state);
+
+  /// Send the outputs of the active filters in one network frame
+  void SendNetworkFrame(double time);
+
+  int NumberOfThreads;
+  bool SweepInParallel;
+  bool SinglePrecision;
+  double SlerpTolerance;
+  int SlerpNumberOfTerms;
+  double DiagnosticsRate;
+  double FilterDeadline;
+  double NetworkMaximumSendRate;
+
 private:
+  class vtkInternal;
+  vtkInternal* Internal;
 
   vtkSlicerTrackerStabilizerLogic(const vtkSlicerTrackerStabilizerLogic&); // Not implemented
   void operator=(const vtkSlicerTrackerStabilizerLogic&);               // Not implemented
@@ -0,0 +1,381 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// TrackerStabilizer Logic includes
+#include "vtkSlicerTrackerStabilizerSyntheticSource.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+//----------------------------------------------------------------------------
+const double TwoPi = 6.283185307179586476925;
+const double ToolSpacing = 100.0; // mm
+
+//----------------------------------------------------------------------------
+// Unit quaternion of the rotation by |vector| radians about vector
+void QuaternionFromRotationVector(const double vector[3], double quaternion[4])
+{
+  const double angle = sqrt(vector[0]*vector[0] + vector[1]*vector[1] + vector[2]*vector[2]);
+  if (angle < 1e-12)
+    {
+    quaternion[0] = 1.0;
+    quaternion[1] = 0.5*vector[0];
+    quaternion[2] = 0.5*vector[1];
+    quaternion[3] = 0.5*vector[2];
+    return;
+    }
+  const double s = sin(0.5*angle) / angle;
+  quaternion[0] = cos(0.5*angle);
+  quaternion[1] = s*vector[0];
+  quaternion[2] = s*vector[1];
+  quaternion[3] = s*vector[2];
+}
+
+//----------------------------------------------------------------------------
+void MultiplyQuaternion(const double a[4], const double b[4], double result[4])
+{
+  const double w = a[0]*b[0] - a[1]*b[1] - a[2]*b[2] - a[3]*b[3];
+  const double x = a[0]*b[1] + a[1]*b[0] + a[2]*b[3] - a[3]*b[2];
+  const double y = a[0]*b[2] - a[1]*b[3] + a[2]*b[0] + a[3]*b[1];
+  const double z = a[0]*b[3] + a[1]*b[2] - a[2]*b[1] + a[3]*b[0];
+  result[0] = w;
+  result[1] = x;
+  result[2] = y;
+  result[3] = z;
+}
+
+//----------------------------------------------------------------------------
+// Seed scrambler, so that neighbouring seeds give unrelated streams
+vtkTypeUInt64 SplitMix64(vtkTypeUInt64 x)
+{
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerTrackerStabilizerSyntheticSource);
+
+//----------------------------------------------------------------------------
+vtkSlicerTrackerStabilizerSyntheticSource::vtkSlicerTrackerStabilizerSyntheticSource()
+{
+  this->NumberOfTools = 0;
+  this->Seed = 1;
+  this->Trajectory = TrajectoryLissajous;
+  this->TranslationAmplitude = 20.0;
+  this->RotationAmplitude = 10.0;
+  this->Frequency = 0.2;
+  this->PositionNoise = 0.2;
+  this->RotationNoise = 0.1;
+  this->DropoutProbability = 0.0;
+  this->OutlierProbability = 0.0;
+  this->OutlierMagnitude = 10.0;
+  this->Rate = 60.0;
+  this->Time = 0.0;
+  this->TransferMatrix = vtkMatrix4x4::New();
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerTrackerStabilizerSyntheticSource::~vtkSlicerTrackerStabilizerSyntheticSource()
+{
+  this->TransferMatrix->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerSyntheticSource::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Number of tools: " << this->NumberOfTools << std::endl;
+  os << indent << "Seed: " << this->Seed << std::endl;
+  os << indent << "Trajectory: " << this->Trajectory << std::endl;
+  os << indent << "Translation amplitude: " << this->TranslationAmplitude << std::endl;
+  os << indent << "Rotation amplitude: " << this->RotationAmplitude << std::endl;
+  os << indent << "Frequency: " << this->Frequency << std::endl;
+  os << indent << "Position noise: " << this->PositionNoise << std::endl;
+  os << indent << "Rotation noise: " << this->RotationNoise << std::endl;
+  os << indent << "Dropout probability: " << this->DropoutProbability << std::endl;
+  os << indent << "Outlier probability: " << this->OutlierProbability << std::endl;
+  os << indent << "Outlier magnitude: " << this->OutlierMagnitude << std::endl;
+  os << indent << "Rate: " << this->Rate << std::endl;
+  os << indent << "Time: " << this->Time << std::endl;
+  os << indent << "Number of transform nodes: " << this->TransformNodes.size() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerSyntheticSource::SetNumberOfTools(int numberOfTools)
+{
+  numberOfTools = std::max(numberOfTools, 0);
+  if (this->NumberOfTools == numberOfTools)
+    {
+    return;
+    }
+  this->NumberOfTools = numberOfTools;
+  this->ResetRandomStreams();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerSyntheticSource::SetSeed(unsigned int seed)
+{
+  if (this->Seed == seed)
+    {
+    return;
+    }
+  this->Seed = seed;
+  this->ResetRandomStreams();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerSyntheticSource::ResetRandomStreams()
+{
+  this->RandomStreams.resize(this->NumberOfTools);
+  for (int tool = 0; tool < this->NumberOfTools; ++tool)
+    {
+    RandomStream& stream = this->RandomStreams[tool];
+    stream.State = SplitMix64((static_cast<vtkTypeUInt64>(this->Seed) << 32) ^
+                              static_cast<vtkTypeUInt64>(tool));
+    if (stream.State == 0)
+      {
+      stream.State = 1; // xorshift must not start at 0
+      }
+    stream.HasSpare = false;
+    stream.Spare = 0.0;
+    }
+}
+
+//----------------------------------------------------------------------------
+double vtkSlicerTrackerStabilizerSyntheticSource::Uniform(int tool)
+{
+  // xorshift64*, 53 random bits in [0, 1)
+  vtkTypeUInt64& x = this->RandomStreams[tool].State;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  return static_cast<double>((x * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//----------------------------------------------------------------------------
+double vtkSlicerTrackerStabilizerSyntheticSource::Gaussian(int tool)
+{
+  // Marsaglia polar method, values come in pairs
+  RandomStream& stream = this->RandomStreams[tool];
+  if (stream.HasSpare)
+    {
+    stream.HasSpare = false;
+    return stream.Spare;
+    }
+  double u, v, s;
+  do
+    {
+    u = 2.0*this->Uniform(tool) - 1.0;
+    v = 2.0*this->Uniform(tool) - 1.0;
+    s = u*u + v*v;
+    }
+  while (s >= 1.0 || s == 0.0);
+  s = sqrt(-2.0*log(s) / s);
+  stream.Spare = v*s;
+  stream.HasSpare = true;
+  return u*s;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerSyntheticSource
+::GetGroundTruth(int tool, double time, double quaternion[4], double position[3])
+{
+  const double phase = (this->NumberOfTools > 0) ? TwoPi * tool / this->NumberOfTools : 0.0;
+  const double omega = TwoPi * this->Frequency;
+  const double a = this->TranslationAmplitude;
+  const double r = vtkMath::RadiansFromDegrees(this->RotationAmplitude);
+
+  position[0] = ToolSpacing * (tool % 10);
+  position[1] = ToolSpacing * ((tool / 10) % 10);
+  position[2] = ToolSpacing * (tool / 100);
+
+  double rotation[3] = {0.0, 0.0, phase};
+  switch (this->Trajectory)
+    {
+    case TrajectoryCircle:
+      position[0] += a*cos(omega*time + phase);
+      position[1] += a*sin(omega*time + phase);
+      rotation[2] += r*sin(omega*time + phase);
+      break;
+    case TrajectoryLissajous:
+      position[0] += a*sin(omega*time + phase);
+      position[1] += a*sin(2.0*omega*time + phase);
+      position[2] += a*sin(3.0*omega*time + phase);
+      rotation[0] += r*sin(omega*time + phase);
+      rotation[1] += r*sin(2.0*omega*time + phase);
+      rotation[2] += r*sin(3.0*omega*time + phase);
+      break;
+    case TrajectoryStatic:
+    default:
+      break;
+    }
+  QuaternionFromRotationVector(rotation, quaternion);
+}
+
+//----------------------------------------------------------------------------
+bool vtkSlicerTrackerStabilizerSyntheticSource
+::GenerateSample(int tool, double time, double quaternion[4], double position[3])
+{
+  if (tool < 0 || tool >= this->NumberOfTools)
+    {
+    vtkErrorMacro("GenerateSample: Invalid tool " << tool);
+    return false;
+    }
+
+  // Random numbers are drawn in the same order for every sample, so that a
+  // tool's stream does not depend on the pose
+  const bool dropout = this->Uniform(tool) < this->DropoutProbability;
+  const bool outlier = this->Uniform(tool) < this->OutlierProbability;
+  if (dropout)
+    {
+    return false;
+    }
+
+  this->GetGroundTruth(tool, time, quaternion, position);
+
+  const double rotationNoise = vtkMath::RadiansFromDegrees(this->RotationNoise);
+  double jitter[3];
+  for (int i = 0; i < 3; ++i)
+    {
+    position[i] += this->PositionNoise * this->Gaussian(tool);
+    jitter[i] = rotationNoise * this->Gaussian(tool);
+    }
+  double jitterQuaternion[4];
+  QuaternionFromRotationVector(jitter, jitterQuaternion);
+  MultiplyQuaternion(jitterQuaternion, quaternion, quaternion);
+
+  if (outlier)
+    {
+    double direction[3] = {this->Gaussian(tool), this->Gaussian(tool), this->Gaussian(tool)};
+    const double norm = vtkMath::Normalize(direction);
+    if (norm > 0.0)
+      {
+      for (int i = 0; i < 3; ++i)
+        {
+        position[i] += this->OutlierMagnitude * direction[i];
+        }
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerTrackerStabilizerSyntheticSource
+::GenerateSamples(double time, double* quaternions, double* positions, unsigned char* valid)
+{
+  int numberOfValidSamples = 0;
+  for (int tool = 0; tool < this->NumberOfTools; ++tool)
+    {
+    valid[tool] = this->GenerateSample(tool, time, quaternions + 4*tool, positions + 3*tool) ? 1 : 0;
+    numberOfValidSamples += valid[tool];
+    }
+  return numberOfValidSamples;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerSyntheticSource::AddTransformNode(vtkMRMLLinearTransformNode* node, vtkMRMLLinearTransformNode* groundTruthNode)
+{
+  if (node == NULL)
+    {
+    return;
+    }
+  this->TransformNodes.push_back(node);
+  this->GroundTruthTransformNodes.push_back(groundTruthNode);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerSyntheticSource::RemoveAllTransformNodes()
+{
+  this->TransformNodes.clear();
+  this->GroundTruthTransformNodes.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerTrackerStabilizerSyntheticSource::GetNumberOfTransformNodes()
+{
+  return static_cast<int>(this->TransformNodes.size());
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerSyntheticSource::Step()
+{
+  if (this->Rate > 0.0)
+    {
+    this->Time += 1.0 / this->Rate;
+    }
+
+  const int numberOfNodes = std::min(static_cast<int>(this->TransformNodes.size()), this->NumberOfTools);
+  for (int tool = 0; tool < numberOfNodes; ++tool)
+    {
+    double quaternion[4];
+    double position[3];
+    vtkMRMLLinearTransformNode* groundTruthNode = this->GroundTruthTransformNodes[tool];
+    if (groundTruthNode)
+      {
+      this->GetGroundTruth(tool, this->Time, quaternion, position);
+      this->SetTransform(groundTruthNode, quaternion, position);
+      }
+
+    vtkMRMLLinearTransformNode* node = this->TransformNodes[tool];
+    if (this->GenerateSample(tool, this->Time, quaternion, position) && node)
+      {
+      this->SetTransform(node, quaternion, position);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerSyntheticSource
+::SetTransform(vtkMRMLLinearTransformNode* node, const double quaternion[4], const double position[3])
+{
+  double rotation[3][3];
+  vtkMath::QuaternionToMatrix3x3(quaternion, rotation);
+  this->TransferMatrix->Identity();
+  for (int i = 0; i < 3; ++i)
+    {
+    for (int j = 0; j < 3; ++j)
+      {
+      this->TransferMatrix->Element[i][j] = rotation[i][j];
+      }
+    this->TransferMatrix->Element[i][3] = position[i];
+    }
+  this->TransferMatrix->Modified();
+  node->SetMatrixTransformToParent(this->TransferMatrix);
+}
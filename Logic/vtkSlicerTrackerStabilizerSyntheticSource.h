@@ -0,0 +1,176 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerTrackerStabilizerSyntheticSource - simulated tracker
+// .SECTION Description
+// Generates the poses of a number of simulated tools, to test the stabilizer
+// without a tracker. Each tool follows a ground-truth trajectory; measured
+// poses add Gaussian jitter, dropouts (no sample) and outlier spikes.
+// Samples can be read directly (GenerateSample, GenerateSamples) or written to
+// transform nodes at a fixed rate (AddTransformNode, Step).
+// Every tool has its own random stream, so tools can be generated from
+// several threads and a given Seed always gives the same samples.
+
+#ifndef __vtkSlicerTrackerStabilizerSyntheticSource_h
+#define __vtkSlicerTrackerStabilizerSyntheticSource_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkType.h>
+#include <vtkWeakPointer.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerTrackerStabilizerModuleLogicExport.h"
+
+class vtkMatrix4x4;
+class vtkMRMLLinearTransformNode;
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_TRACKERSTABILIZER_MODULE_LOGIC_EXPORT vtkSlicerTrackerStabilizerSyntheticSource :
+  public vtkObject
+{
+public:
+
+  static vtkSlicerTrackerStabilizerSyntheticSource *New();
+  vtkTypeMacro(vtkSlicerTrackerStabilizerSyntheticSource, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  enum Trajectories
+  {
+    TrajectoryStatic = 0, // Tools at rest
+    TrajectoryCircle,     // Circle in the xy plane, rotation about z
+    TrajectoryLissajous,  // 3D Lissajous curve, rotation about all axes
+    Trajectory_Last
+  };
+
+  /// Number of simulated tools. Tools are laid out on a grid (100 mm apart)
+  /// and their trajectories are out of phase. Resets the random streams.
+  void SetNumberOfTools(int numberOfTools);
+  vtkGetMacro(NumberOfTools, int);
+
+  /// Seed of the random streams. Resets them.
+  void SetSeed(unsigned int seed);
+  vtkGetMacro(Seed, unsigned int);
+
+  /// Ground-truth motion: trajectory, amplitudes (mm, deg) and frequency (Hz)
+  vtkSetClampMacro(Trajectory, int, TrajectoryStatic, Trajectory_Last - 1);
+  vtkGetMacro(Trajectory, int);
+  vtkSetMacro(TranslationAmplitude, double);
+  vtkGetMacro(TranslationAmplitude, double);
+  vtkSetMacro(RotationAmplitude, double);
+  vtkGetMacro(RotationAmplitude, double);
+  vtkSetMacro(Frequency, double);
+  vtkGetMacro(Frequency, double);
+
+  /// Standard deviation of the Gaussian jitter, per axis (mm, deg)
+  vtkSetMacro(PositionNoise, double);
+  vtkGetMacro(PositionNoise, double);
+  vtkSetMacro(RotationNoise, double);
+  vtkGetMacro(RotationNoise, double);
+
+  /// Probability that a sample is missing (tool out of view)
+  vtkSetClampMacro(DropoutProbability, double, 0.0, 1.0);
+  vtkGetMacro(DropoutProbability, double);
+
+  /// Probability that a sample is an outlier, displaced by OutlierMagnitude
+  /// (mm) in a random direction
+  vtkSetClampMacro(OutlierProbability, double, 0.0, 1.0);
+  vtkGetMacro(OutlierProbability, double);
+  vtkSetMacro(OutlierMagnitude, double);
+  vtkGetMacro(OutlierMagnitude, double);
+
+  /// Ground-truth pose of a tool at a time (s)
+  void GetGroundTruth(int tool, double time, double quaternion[4], double position[3]);
+
+  /// Measured pose of a tool at a time. Returns false for a dropout, in
+  /// which case the pose is not set.
+  bool GenerateSample(int tool, double time, double quaternion[4], double position[3]);
+
+  /// Measured poses of all tools: quaternions (4 per tool), positions (3 per
+  /// tool) and valid (1 per tool, 0 for a dropout). Returns the number of
+  /// valid samples.
+  int GenerateSamples(double time, double* quaternions, double* positions, unsigned char* valid);
+
+  /// Transform nodes driven by Step, one per tool in the order they are
+  /// added. The optional ground truth node receives the ground-truth pose,
+  /// also when the sample is dropped.
+  void AddTransformNode(vtkMRMLLinearTransformNode* node,
+                        vtkMRMLLinearTransformNode* groundTruthNode = NULL);
+  void RemoveAllTransformNodes();
+  int GetNumberOfTransformNodes();
+
+  /// Sample rate (Hz) of Step
+  vtkSetMacro(Rate, double);
+  vtkGetMacro(Rate, double);
+
+  /// Simulated time (s), advanced by 1/Rate by Step
+  vtkSetMacro(Time, double);
+  vtkGetMacro(Time, double);
+
+  /// Advance the simulated time by one sample and write the measured poses
+  /// to the transform nodes. Nodes of dropped samples are not modified.
+  void Step();
+
+protected:
+  vtkSlicerTrackerStabilizerSyntheticSource();
+  virtual ~vtkSlicerTrackerStabilizerSyntheticSource();
+
+  void ResetRandomStreams();
+  void SetTransform(vtkMRMLLinearTransformNode* node, const double quaternion[4], const double position[3]);
+
+  // Random numbers, xorshift64* generator per tool
+  double Uniform(int tool);
+  double Gaussian(int tool);
+
+  int NumberOfTools;
+  unsigned int Seed;
+  int Trajectory;
+  double TranslationAmplitude;
+  double RotationAmplitude;
+  double Frequency;
+  double PositionNoise;
+  double RotationNoise;
+  double DropoutProbability;
+  double OutlierProbability;
+  double OutlierMagnitude;
+  double Rate;
+  double Time;
+
+  struct RandomStream
+  {
+    vtkTypeUInt64 State;
+    bool HasSpare;
+    double Spare;
+  };
+  std::vector<RandomStream> RandomStreams;
+  std::vector< vtkWeakPointer<vtkMRMLLinearTransformNode> > TransformNodes;
+  std::vector< vtkWeakPointer<vtkMRMLLinearTransformNode> > GroundTruthTransformNodes;
+  vtkMatrix4x4* TransferMatrix;
+
+private:
+  vtkSlicerTrackerStabilizerSyntheticSource(const vtkSlicerTrackerStabilizerSyntheticSource&); // Not implemented
+  void operator=(const vtkSlicerTrackerStabilizerSyntheticSource&);                         // Not implemented
+};
+
+#endif
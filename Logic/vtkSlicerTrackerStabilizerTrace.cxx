@@ -0,0 +1,291 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// TrackerStabilizer Logic includes
+#include "vtkSlicerTrackerStabilizerTrace.h"
+
+// VTK includes
+#include <vtkTimerLog.h>
+#include <vtkType.h>
+
+// STD includes
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <locale>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Number of events kept per thread
+const vtkTypeUInt64 TraceCapacity = 16384;
+
+//----------------------------------------------------------------------------
+struct TraceEvent
+{
+  const char* Name;
+  double Start;
+  double Duration;
+  char Argument[vtkSlicerTrackerStabilizerTrace::ArgumentLength];
+};
+
+//----------------------------------------------------------------------------
+// Ring of the events of one thread. Only the owner thread writes events and
+// Count (with release semantics). Readers copy the events below Count and
+// drop those the owner may have overwritten meanwhile. Rings are kept in a
+// list that only grows, so threads register without locks.
+// When its thread exits, a ring is marked free and the next thread that
+// traces takes it over (with its trace lane) instead of allocating a new
+// one, so there are never more rings than threads tracing at the same time.
+// Rings are never deleted: a thread may still write to its ring while the
+// library is unloaded.
+struct TraceBuffer
+{
+  TraceBuffer()
+    : Count(0), First(0), InUse(true), ThreadIndex(0), Next(NULL)
+  {
+  }
+
+  TraceEvent Events[TraceCapacity];
+  std::atomic<vtkTypeUInt64> Count;
+  // Count at the last Clear, events below are not written
+  std::atomic<vtkTypeUInt64> First;
+  // Owned by a running thread
+  std::atomic<bool> InUse;
+  int ThreadIndex;
+  TraceBuffer* Next;
+};
+
+std::atomic<TraceBuffer*> TraceBuffers(NULL);
+std::atomic<int> NumberOfTraceBuffers(0);
+// Time origin of the written events, set when tracing starts
+double TraceOrigin = 0.0;
+
+//----------------------------------------------------------------------------
+// Ring of the calling thread, released when the thread exits
+struct ThreadTraceBufferOwner
+{
+  ThreadTraceBufferOwner()
+    : Buffer(NULL)
+  {
+  }
+  ~ThreadTraceBufferOwner()
+  {
+    if (this->Buffer)
+      {
+      this->Buffer->InUse.store(false, std::memory_order_release);
+      }
+  }
+
+  TraceBuffer* Buffer;
+};
+thread_local ThreadTraceBufferOwner ThreadTraceBuffer;
+
+//----------------------------------------------------------------------------
+TraceBuffer* AcquireTraceBuffer()
+{
+  // Take over the ring of a thread that has exited
+  for (TraceBuffer* buffer = TraceBuffers.load(std::memory_order_acquire);
+       buffer; buffer = buffer->Next)
+    {
+    bool inUse = false;
+    if (!buffer->InUse.load(std::memory_order_relaxed) &&
+        buffer->InUse.compare_exchange_strong(inUse, true, std::memory_order_acquire,
+                                              std::memory_order_relaxed))
+      {
+      return buffer;
+      }
+    }
+
+  TraceBuffer* buffer = new TraceBuffer;
+  buffer->ThreadIndex = NumberOfTraceBuffers.fetch_add(1, std::memory_order_relaxed);
+  buffer->Next = TraceBuffers.load(std::memory_order_relaxed);
+  while (!TraceBuffers.compare_exchange_weak(buffer->Next, buffer,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed))
+    {
+    }
+  return buffer;
+}
+
+//----------------------------------------------------------------------------
+TraceBuffer* GetThreadTraceBuffer()
+{
+  if (ThreadTraceBuffer.Buffer == NULL)
+    {
+    ThreadTraceBuffer.Buffer = AcquireTraceBuffer();
+    }
+  return ThreadTraceBuffer.Buffer;
+}
+
+//----------------------------------------------------------------------------
+void CopyArgument(char* destination, const char* argument)
+{
+  if (argument == NULL)
+    {
+    destination[0] = '\0';
+    return;
+    }
+  strncpy(destination, argument, vtkSlicerTrackerStabilizerTrace::ArgumentLength - 1);
+  destination[vtkSlicerTrackerStabilizerTrace::ArgumentLength - 1] = '\0';
+}
+
+//----------------------------------------------------------------------------
+void WriteJSONString(std::ostream& stream, const char* text)
+{
+  stream << '"';
+  for (const char* c = text; *c; ++c)
+    {
+    if (*c == '"' || *c == '\\')
+      {
+      stream << '\\' << *c;
+      }
+    else if (static_cast<unsigned char>(*c) >= 0x20)
+      {
+      stream << *c;
+      }
+    }
+  stream << '"';
+}
+
+} // end of anonymous namespace
+
+std::atomic<int> vtkSlicerTrackerStabilizerTrace::Enabled(0);
+
+//----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerTrace::SetEnabled(bool enabled)
+{
+  if (enabled && !GetEnabled())
+    {
+    Clear();
+    TraceOrigin = vtkTimerLog::GetUniversalTime();
+    }
+  Enabled.store(enabled ? 1 : 0, std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerTrace::Clear()
+{
+  for (TraceBuffer* buffer = TraceBuffers.load(std::memory_order_acquire);
+       buffer; buffer = buffer->Next)
+    {
+    buffer->First.store(buffer->Count.load(std::memory_order_acquire),
+                        std::memory_order_relaxed);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerTrace::Record(const char* name, const char* argument,
+                                             double start, double end)
+{
+  TraceBuffer* buffer = GetThreadTraceBuffer();
+  const vtkTypeUInt64 count = buffer->Count.load(std::memory_order_relaxed);
+  TraceEvent& event = buffer->Events[count % TraceCapacity];
+  event.Name = name;
+  event.Start = start;
+  event.Duration = end - start;
+  CopyArgument(event.Argument, argument);
+  buffer->Count.store(count + 1, std::memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+bool vtkSlicerTrackerStabilizerTrace::WriteChromeTrace(const char* fileName)
+{
+  if (fileName == NULL)
+    {
+    return false;
+    }
+  std::ofstream file(fileName);
+  if (!file)
+    {
+    return false;
+    }
+  // JSON numbers always use a dot, whatever the global locale
+  file.imbue(std::locale::classic());
+  file << std::fixed << std::setprecision(3);
+
+  file << "{\"traceEvents\":[";
+  bool first = true;
+  std::vector<TraceEvent> events;
+  for (TraceBuffer* buffer = TraceBuffers.load(std::memory_order_acquire);
+       buffer; buffer = buffer->Next)
+    {
+    // Copy, then drop the events that may have been overwritten meanwhile
+    const vtkTypeUInt64 end = buffer->Count.load(std::memory_order_acquire);
+    vtkTypeUInt64 begin = std::max(buffer->First.load(std::memory_order_relaxed),
+                                   (end > TraceCapacity) ? end - TraceCapacity : 0);
+    begin = std::min(begin, end);
+    events.resize(static_cast<size_t>(end - begin));
+    for (vtkTypeUInt64 i = begin; i < end; ++i)
+      {
+      events[static_cast<size_t>(i - begin)] = buffer->Events[i % TraceCapacity];
+      }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const vtkTypeUInt64 written = buffer->Count.load(std::memory_order_relaxed);
+    const vtkTypeUInt64 firstValid = (written >= TraceCapacity) ? written - TraceCapacity + 1 : 0;
+    const size_t overwritten = (firstValid > begin) ?
+      static_cast<size_t>(std::min(firstValid, end) - begin) : 0;
+
+    // Complete events, in microseconds since tracing started
+    for (size_t i = overwritten; i < events.size(); ++i)
+      {
+      const TraceEvent& event = events[i];
+      file << (first ? "" : ",") << "\n{\"name\":";
+      WriteJSONString(file, event.Name);
+      file << ",\"cat\":\"TrackerStabilizer\",\"ph\":\"X\""
+           << ",\"ts\":" << (event.Start - TraceOrigin) * 1e6
+           << ",\"dur\":" << event.Duration * 1e6
+           << ",\"pid\":1,\"tid\":" << buffer->ThreadIndex;
+      if (event.Argument[0])
+        {
+        file << ",\"args\":{\"node\":";
+        WriteJSONString(file, event.Argument);
+        file << "}";
+        }
+      file << "}";
+      first = false;
+      }
+    }
+  file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+  file.close();
+  return !file.fail();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerTrace::Scope::Start(const char* argument)
+{
+  CopyArgument(this->Argument, argument);
+  this->StartTime = vtkTimerLog::GetUniversalTime();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerTrackerStabilizerTrace::Scope::Stop()
+{
+  vtkSlicerTrackerStabilizerTrace::Record(this->Name, this->Argument, this->StartTime,
+                                          vtkTimerLog::GetUniversalTime());
+}
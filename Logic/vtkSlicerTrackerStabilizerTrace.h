@@ -0,0 +1,115 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerTrackerStabilizerTrace - scoped trace points
+// .SECTION Description
+// Records the duration of named scopes (event receipt, computation and
+// publishing of each filter) to tell where time goes when the output
+// stutters. Each thread writes to its own ring of the last events, without
+// locks; WriteChromeTrace dumps all rings as Chrome trace-event JSON, to be
+// opened in chrome://tracing or Perfetto.
+// Tracing is process-wide and off by default. When off, a trace point costs
+// one flag test and nothing is allocated.
+
+#ifndef __vtkSlicerTrackerStabilizerTrace_h
+#define __vtkSlicerTrackerStabilizerTrace_h
+
+#include "vtkSlicerTrackerStabilizerModuleLogicExport.h"
+
+// STD includes
+#include <atomic>
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_TRACKERSTABILIZER_MODULE_LOGIC_EXPORT vtkSlicerTrackerStabilizerTrace
+{
+public:
+
+  /// Maximum length of the argument of a trace point (e.g. node ID)
+  enum { ArgumentLength = 40 };
+
+  /// Start or stop recording. Starting also clears the previous events.
+  static void SetEnabled(bool enabled);
+  static bool GetEnabled()
+  {
+    return Enabled.load(std::memory_order_relaxed) != 0;
+  }
+
+  /// Forget the recorded events
+  static void Clear();
+
+  /// Record a scope of the calling thread. name must be a string literal,
+  /// argument is copied. Times are in seconds (vtkTimerLog::GetUniversalTime).
+  static void Record(const char* name, const char* argument, double start, double end);
+
+  /// Write the events recorded by all threads since the last Clear, oldest
+  /// first. Each thread keeps its last 16384 events. Returns false if the
+  /// file cannot be written.
+  static bool WriteChromeTrace(const char* fileName);
+
+  /// Records the lifetime of the object, if tracing is enabled when it is
+  /// created. See vtkTrackerStabilizerTraceMacro.
+  class VTK_SLICER_TRACKERSTABILIZER_MODULE_LOGIC_EXPORT Scope
+  {
+  public:
+    Scope(const char* name, const char* argument = 0);
+    ~Scope();
+
+  private:
+    void Start(const char* argument);
+    void Stop();
+
+    const char* Name;
+    double StartTime;
+    char Argument[ArgumentLength];
+
+    Scope(const Scope&);           // Not implemented
+    void operator=(const Scope&);  // Not implemented
+  };
+
+private:
+  static std::atomic<int> Enabled;
+};
+
+//----------------------------------------------------------------------------
+inline vtkSlicerTrackerStabilizerTrace::Scope::Scope(const char* name, const char* argument)
+  : Name(name), StartTime(-1.0)
+{
+  if (vtkSlicerTrackerStabilizerTrace::GetEnabled())
+    {
+    this->Start(argument);
+    }
+}
+
+//----------------------------------------------------------------------------
+inline vtkSlicerTrackerStabilizerTrace::Scope::~Scope()
+{
+  if (this->StartTime >= 0.0)
+    {
+    this->Stop();
+    }
+}
+
+/// Trace point lasting until the end of the enclosing block
+#define vtkTrackerStabilizerTraceMacro(name, argument) \
+  vtkSlicerTrackerStabilizerTrace::Scope vtkTrackerStabilizerTraceScope(name, argument)
+
+#endif
@@ -32,11 +32,50 @@
 #include <vtkCommand.h>
 
 // Other includes
+#include <cstring>
+#include <locale>
 #include <sstream>
 
 // Constants
 static const char* INPUT_TRANSFORM_ROLE = "inputTransformNode";
 static const char* FILTERED_TRANSFORM_ROLE = "filteredTransformNode";
+static const char* REFERENCE_TRANSFORM_ROLE = "referenceTransformNode";
+static const char* TOOLTIP_TRANSFORM_ROLE = "toolTipTransformNode";
+static const char* GROUNDTRUTH_TRANSFORM_ROLE = "groundTruthTransformNode";
+
+//-----------------------------------------------------------------------------
+// Read up to count space separated numbers, always with a decimal dot.
+// Returns the number of values read; the others are left unchanged.
+static int ReadDoubles( const char* text, double* values, int count )
+{
+  std::stringstream ss;
+  ss.imbue(std::locale::classic());
+  ss << text;
+  int numberOfValues = 0;
+  double value = 0.0;
+  while (numberOfValues < count && ss >> value)
+    {
+    values[numberOfValues++] = value;
+    }
+  return numberOfValues;
+}
+
+//-----------------------------------------------------------------------------
+// Read one integer. Returns false, leaving value unchanged, if the text is
+// not an integer or does not fit in an int.
+static bool ReadInt( const char* text, int* value )
+{
+  std::stringstream ss;
+  ss.imbue(std::locale::classic());
+  ss << text;
+  int result = 0;
+  if (!(ss >> result))
+    {
+    return false;
+    }
+  *value = result;
+  return true;
+}
 
 //-----------------------------------------------------------------------------
 vtkMRMLNodeNewMacro(vtkMRMLTrackerStabilizerNode);
@@ -52,9 +91,46 @@ vtkMRMLTrackerStabilizerNode
 
   this->AddNodeReferenceRole( INPUT_TRANSFORM_ROLE, NULL, events.GetPointer() );
   this->AddNodeReferenceRole( FILTERED_TRANSFORM_ROLE, NULL, events.GetPointer() );
+  this->AddNodeReferenceRole( REFERENCE_TRANSFORM_ROLE, NULL, events.GetPointer() );
+  this->AddNodeReferenceRole( TOOLTIP_TRANSFORM_ROLE );
+  this->AddNodeReferenceRole( GROUNDTRUTH_TRANSFORM_ROLE );
 
   this->CutOffFrequency = 7.5;
   this->FilterActivated = false;
+  this->WarmStartMode = WarmStartFromInput;
+
+  this->SeparateCutOffFrequencies = false;
+  this->RotationCutOffFrequency = 7.5;
+  this->TranslationCutOffFrequency[0] = 7.5;
+  this->TranslationCutOffFrequency[1] = 7.5;
+  this->TranslationCutOffFrequency[2] = 7.5;
+  this->TranslationCutOffFrame = CutOffFrameCamera;
+
+  this->ToolTipOffset[0] = 0.0;
+  this->ToolTipOffset[1] = 0.0;
+  this->ToolTipOffset[2] = 0.0;
+  this->TargetToolTipJitter = 0.0;
+
+  this->ConvergencePositionTolerance = 0.01;
+  this->ConvergenceRotationTolerance = 0.01;
+
+  this->SaveFilterState = false;
+  this->ClearFilterState();
+
+  this->MotionDetection = false;
+  this->SlowTranslationSpeed = 5.0;
+  this->FastTranslationSpeed = 50.0;
+  this->SlowRotationSpeed = 5.0;
+  this->FastRotationSpeed = 45.0;
+  this->MotionHysteresis = 0.2;
+  this->SlowCutOffFrequencyScale = 4.0;
+  this->MotionTransitionTime = 0.1;
+  this->MotionState = MotionStationary;
+
+  this->Priority = 0;
+  this->MaximumUpdateRate = 0.0;
+  this->GroupID = 0;
+  this->GroupOffsetCutOffFrequency = 0.5;
 }
 
 //-----------------------------------------------------------------------------
@@ -72,12 +148,51 @@ void vtkMRMLTrackerStabilizerNode
 
   of << indent << " cutoffFrequency=\"" << this->CutOffFrequency << "\"";
   of << indent << " filterActivated=\"" << ( this->FilterActivated ? "true" : "false" ) << "\"";
+  of << indent << " warmStartMode=\"" << GetWarmStartModeAsString(this->WarmStartMode) << "\"";
+  of << indent << " separateCutoffFrequencies=\"" << ( this->SeparateCutOffFrequencies ? "true" : "false" ) << "\"";
+  of << indent << " rotationCutoffFrequency=\"" << this->RotationCutOffFrequency << "\"";
+  of << indent << " translationCutoffFrequency=\"" << this->TranslationCutOffFrequency[0] << " "
+     << this->TranslationCutOffFrequency[1] << " " << this->TranslationCutOffFrequency[2] << "\"";
+  of << indent << " translationCutoffFrame=\"" << GetCutOffFrameAsString(this->TranslationCutOffFrame) << "\"";
+  of << indent << " toolTipOffset=\"" << this->ToolTipOffset[0] << " "
+     << this->ToolTipOffset[1] << " " << this->ToolTipOffset[2] << "\"";
+  of << indent << " targetToolTipJitter=\"" << this->TargetToolTipJitter << "\"";
+  of << indent << " convergencePositionTolerance=\"" << this->ConvergencePositionTolerance << "\"";
+  of << indent << " convergenceRotationTolerance=\"" << this->ConvergenceRotationTolerance << "\"";
+  of << indent << " motionDetection=\"" << ( this->MotionDetection ? "true" : "false" ) << "\"";
+  of << indent << " slowTranslationSpeed=\"" << this->SlowTranslationSpeed << "\"";
+  of << indent << " fastTranslationSpeed=\"" << this->FastTranslationSpeed << "\"";
+  of << indent << " slowRotationSpeed=\"" << this->SlowRotationSpeed << "\"";
+  of << indent << " fastRotationSpeed=\"" << this->FastRotationSpeed << "\"";
+  of << indent << " motionHysteresis=\"" << this->MotionHysteresis << "\"";
+  of << indent << " slowCutoffFrequencyScale=\"" << this->SlowCutOffFrequencyScale << "\"";
+  of << indent << " motionTransitionTime=\"" << this->MotionTransitionTime << "\"";
+  of << indent << " priority=\"" << this->Priority << "\"";
+  of << indent << " maximumUpdateRate=\"" << this->MaximumUpdateRate << "\"";
+  of << indent << " groupID=\"" << this->GroupID << "\"";
+  of << indent << " groupOffsetCutoffFrequency=\"" << this->GroupOffsetCutOffFrequency << "\"";
+  of << indent << " saveFilterState=\"" << ( this->SaveFilterState ? "true" : "false" ) << "\"";
+
+  if (this->SaveFilterState && this->FilterStateValid)
+    {
+    // Full precision so that the filter resumes exactly where it stopped
+    std::stringstream ss;
+    ss.imbue(std::locale::classic());
+    ss.precision(17);
+    ss << this->FilterStateQuaternion[0] << " " << this->FilterStateQuaternion[1] << " "
+       << this->FilterStateQuaternion[2] << " " << this->FilterStateQuaternion[3] << " "
+       << this->FilterStatePosition[0] << " " << this->FilterStatePosition[1] << " "
+       << this->FilterStatePosition[2];
+    of << indent << " filterState=\"" << ss.str() << "\"";
+    }
 }
 
 //-----------------------------------------------------------------------------
 void vtkMRMLTrackerStabilizerNode
 ::ReadXMLAttributes( const char** atts )
 {
+  int disabledModify = this->StartModify();
+
   Superclass::ReadXMLAttributes(atts);
 
   // Read all MRML node attributes from two arrays of names and values
@@ -91,24 +206,192 @@ void vtkMRMLTrackerStabilizerNode
 
     if (!strcmp(attName, "cutoffFrequency"))
       {
-      std::stringstream ss;
-      ss << attValue;
-      double val;
-      ss >> val;
-      this->CutOffFrequency = val;
+      double value = 0.0;
+      if (ReadDoubles(attValue, &value, 1) == 1)
+        {
+        this->SetCutOffFrequency(value);
+        }
       }
     else if(!strcmp(attName, "filterActivated"))
       {
-      if (!strcmp(attValue,"true"))
-	{
-	this->FilterActivated = true;
-	}
-      else
-	{
-	this->FilterActivated = false;
-	}
+      this->SetFilterActivated(strcmp(attValue,"true") == 0);
+      }
+    else if (!strcmp(attName, "warmStartMode"))
+      {
+      int mode = GetWarmStartModeFromString(attValue);
+      if (mode >= 0)
+        {
+        this->SetWarmStartMode(mode);
+        }
+      }
+    else if (!strcmp(attName, "separateCutoffFrequencies"))
+      {
+      this->SetSeparateCutOffFrequencies(strcmp(attValue,"true") == 0);
+      }
+    else if (!strcmp(attName, "rotationCutoffFrequency"))
+      {
+      double value = 0.0;
+      if (ReadDoubles(attValue, &value, 1) == 1)
+        {
+        this->SetRotationCutOffFrequency(value);
+        }
+      }
+    else if (!strcmp(attName, "translationCutoffFrequency"))
+      {
+      double values[3];
+      if (ReadDoubles(attValue, values, 3) == 3)
+        {
+        this->SetTranslationCutOffFrequency(values);
+        }
+      }
+    else if (!strcmp(attName, "translationCutoffFrame"))
+      {
+      int frame = GetCutOffFrameFromString(attValue);
+      if (frame >= 0)
+        {
+        this->SetTranslationCutOffFrame(frame);
+        }
+      }
+    else if (!strcmp(attName, "toolTipOffset"))
+      {
+      double values[3];
+      if (ReadDoubles(attValue, values, 3) == 3)
+        {
+        this->SetToolTipOffset(values);
+        }
+      }
+    else if (!strcmp(attName, "targetToolTipJitter"))
+      {
+      double value = 0.0;
+      if (ReadDoubles(attValue, &value, 1) == 1)
+        {
+        this->SetTargetToolTipJitter(value);
+        }
+      }
+    else if (!strcmp(attName, "convergencePositionTolerance"))
+      {
+      double value = 0.0;
+      if (ReadDoubles(attValue, &value, 1) == 1)
+        {
+        this->SetConvergencePositionTolerance(value);
+        }
+      }
+    else if (!strcmp(attName, "convergenceRotationTolerance"))
+      {
+      double value = 0.0;
+      if (ReadDoubles(attValue, &value, 1) == 1)
+        {
+        this->SetConvergenceRotationTolerance(value);
+        }
+      }
+    else if (!strcmp(attName, "motionDetection"))
+      {
+      this->SetMotionDetection(strcmp(attValue,"true") == 0);
+      }
+    else if (!strcmp(attName, "slowTranslationSpeed"))
+      {
+      double value = 0.0;
+      if (ReadDoubles(attValue, &value, 1) == 1)
+        {
+        this->SetSlowTranslationSpeed(value);
+        }
+      }
+    else if (!strcmp(attName, "fastTranslationSpeed"))
+      {
+      double value = 0.0;
+      if (ReadDoubles(attValue, &value, 1) == 1)
+        {
+        this->SetFastTranslationSpeed(value);
+        }
+      }
+    else if (!strcmp(attName, "slowRotationSpeed"))
+      {
+      double value = 0.0;
+      if (ReadDoubles(attValue, &value, 1) == 1)
+        {
+        this->SetSlowRotationSpeed(value);
+        }
+      }
+    else if (!strcmp(attName, "fastRotationSpeed"))
+      {
+      double value = 0.0;
+      if (ReadDoubles(attValue, &value, 1) == 1)
+        {
+        this->SetFastRotationSpeed(value);
+        }
+      }
+    else if (!strcmp(attName, "motionHysteresis"))
+      {
+      double value = 0.0;
+      if (ReadDoubles(attValue, &value, 1) == 1)
+        {
+        this->SetMotionHysteresis(value);
+        }
+      }
+    else if (!strcmp(attName, "slowCutoffFrequencyScale"))
+      {
+      double value = 0.0;
+      if (ReadDoubles(attValue, &value, 1) == 1)
+        {
+        this->SetSlowCutOffFrequencyScale(value);
+        }
+      }
+    else if (!strcmp(attName, "motionTransitionTime"))
+      {
+      double value = 0.0;
+      if (ReadDoubles(attValue, &value, 1) == 1)
+        {
+        this->SetMotionTransitionTime(value);
+        }
+      }
+    else if (!strcmp(attName, "priority"))
+      {
+      int priority = 0;
+      if (ReadInt(attValue, &priority))
+        {
+        this->SetPriority(priority);
+        }
+      }
+    else if (!strcmp(attName, "maximumUpdateRate"))
+      {
+      double value = 0.0;
+      if (ReadDoubles(attValue, &value, 1) == 1)
+        {
+        this->SetMaximumUpdateRate(value);
+        }
+      }
+    else if (!strcmp(attName, "groupID"))
+      {
+      int groupID = 0;
+      if (ReadInt(attValue, &groupID))
+        {
+        this->SetGroupID(groupID);
+        }
+      }
+    else if (!strcmp(attName, "groupOffsetCutoffFrequency"))
+      {
+      double value = 0.0;
+      if (ReadDoubles(attValue, &value, 1) == 1)
+        {
+        this->SetGroupOffsetCutOffFrequency(value);
+        }
+      }
+    else if (!strcmp(attName, "saveFilterState"))
+      {
+      this->SetSaveFilterState(strcmp(attValue,"true") == 0);
+      }
+    else if (!strcmp(attName, "filterState"))
+      {
+      // Quaternion (w, x, y, z) then position
+      double values[7];
+      if (ReadDoubles(attValue, values, 7) == 7)
+        {
+        this->SetFilterState(values, values + 4);
+        }
       }
     }
+
+  this->EndModify(disabledModify);
 }
 
 //-----------------------------------------------------------------------------
@@ -121,6 +404,40 @@ void vtkMRMLTrackerStabilizerNode
 
   this->CutOffFrequency = node->CutOffFrequency;
   this->FilterActivated = node->FilterActivated;
+  this->WarmStartMode = node->WarmStartMode;
+  this->SeparateCutOffFrequencies = node->SeparateCutOffFrequencies;
+  this->RotationCutOffFrequency = node->RotationCutOffFrequency;
+  this->TranslationCutOffFrequency[0] = node->TranslationCutOffFrequency[0];
+  this->TranslationCutOffFrequency[1] = node->TranslationCutOffFrequency[1];
+  this->TranslationCutOffFrequency[2] = node->TranslationCutOffFrequency[2];
+  this->TranslationCutOffFrame = node->TranslationCutOffFrame;
+  this->ToolTipOffset[0] = node->ToolTipOffset[0];
+  this->ToolTipOffset[1] = node->ToolTipOffset[1];
+  this->ToolTipOffset[2] = node->ToolTipOffset[2];
+  this->TargetToolTipJitter = node->TargetToolTipJitter;
+  this->ConvergencePositionTolerance = node->ConvergencePositionTolerance;
+  this->ConvergenceRotationTolerance = node->ConvergenceRotationTolerance;
+  this->SaveFilterState = node->SaveFilterState;
+  if (node->FilterStateValid)
+    {
+    this->SetFilterState(node->FilterStateQuaternion, node->FilterStatePosition);
+    }
+  else
+    {
+    this->ClearFilterState();
+    }
+  this->MotionDetection = node->MotionDetection;
+  this->SlowTranslationSpeed = node->SlowTranslationSpeed;
+  this->FastTranslationSpeed = node->FastTranslationSpeed;
+  this->SlowRotationSpeed = node->SlowRotationSpeed;
+  this->FastRotationSpeed = node->FastRotationSpeed;
+  this->MotionHysteresis = node->MotionHysteresis;
+  this->SlowCutOffFrequencyScale = node->SlowCutOffFrequencyScale;
+  this->MotionTransitionTime = node->MotionTransitionTime;
+  this->Priority = node->Priority;
+  this->MaximumUpdateRate = node->MaximumUpdateRate;
+  this->GroupID = node->GroupID;
+  this->GroupOffsetCutOffFrequency = node->GroupOffsetCutOffFrequency;
 
   this->Modified();
 }
@@ -133,8 +450,196 @@ void vtkMRMLTrackerStabilizerNode
 
   os << indent << "InputTransformNodeID: " << this->GetInputTransformNode()->GetID() << std::endl;
   os << indent << "FilteredTransformNodeID: " << this->GetFilteredTransformNode()->GetID() << std::endl;
+  const char* referenceNodeId = this->GetNodeReferenceID( REFERENCE_TRANSFORM_ROLE );
+  os << indent << "ReferenceTransformNodeID: " << ( referenceNodeId ? referenceNodeId : "(none)" ) << std::endl;
   os << indent << "CutOff Frequency: " << this->CutOffFrequency << std::endl;
   os << indent << "Filter Activated: " << this->FilterActivated << std::endl;
+  os << indent << "Warm Start Mode: " << GetWarmStartModeAsString(this->WarmStartMode) << std::endl;
+  os << indent << "Separate CutOff Frequencies: " << this->SeparateCutOffFrequencies << std::endl;
+  os << indent << "Rotation CutOff Frequency: " << this->RotationCutOffFrequency << std::endl;
+  os << indent << "Translation CutOff Frequency: " << this->TranslationCutOffFrequency[0] << " "
+     << this->TranslationCutOffFrequency[1] << " " << this->TranslationCutOffFrequency[2] << std::endl;
+  os << indent << "Translation CutOff Frame: " << GetCutOffFrameAsString(this->TranslationCutOffFrame) << std::endl;
+  os << indent << "Tool Tip Offset: " << this->ToolTipOffset[0] << " "
+     << this->ToolTipOffset[1] << " " << this->ToolTipOffset[2] << std::endl;
+  os << indent << "Target Tool Tip Jitter: " << this->TargetToolTipJitter << std::endl;
+  os << indent << "Convergence Position Tolerance: " << this->ConvergencePositionTolerance << std::endl;
+  os << indent << "Convergence Rotation Tolerance: " << this->ConvergenceRotationTolerance << std::endl;
+  os << indent << "Motion Detection: " << this->MotionDetection << std::endl;
+  os << indent << "Slow Translation Speed: " << this->SlowTranslationSpeed << std::endl;
+  os << indent << "Fast Translation Speed: " << this->FastTranslationSpeed << std::endl;
+  os << indent << "Slow Rotation Speed: " << this->SlowRotationSpeed << std::endl;
+  os << indent << "Fast Rotation Speed: " << this->FastRotationSpeed << std::endl;
+  os << indent << "Motion Hysteresis: " << this->MotionHysteresis << std::endl;
+  os << indent << "Slow CutOff Frequency Scale: " << this->SlowCutOffFrequencyScale << std::endl;
+  os << indent << "Motion Transition Time: " << this->MotionTransitionTime << std::endl;
+  os << indent << "Motion State: " << GetMotionStateAsString(this->MotionState) << std::endl;
+  os << indent << "Priority: " << this->Priority << std::endl;
+  os << indent << "Maximum Update Rate: " << this->MaximumUpdateRate << std::endl;
+  os << indent << "Group ID: " << this->GroupID << std::endl;
+  os << indent << "Group Offset CutOff Frequency: " << this->GroupOffsetCutOffFrequency << std::endl;
+  os << indent << "Save Filter State: " << this->SaveFilterState << std::endl;
+  if (this->FilterStateValid)
+    {
+    os << indent << "Filter State: " << this->FilterStateQuaternion[0] << " "
+       << this->FilterStateQuaternion[1] << " " << this->FilterStateQuaternion[2] << " "
+       << this->FilterStateQuaternion[3] << " " << this->FilterStatePosition[0] << " "
+       << this->FilterStatePosition[1] << " " << this->FilterStatePosition[2] << std::endl;
+    }
+}
+
+//-----------------------------------------------------------------------------
+const char* vtkMRMLTrackerStabilizerNode
+::GetMotionStateAsString( int state )
+{
+  switch (state)
+    {
+    case MotionStationary: return "Stationary";
+    case MotionSlow: return "Slow";
+    case MotionFast: return "Fast";
+    default:
+      break;
+    }
+  return "Unknown";
+}
+
+//-----------------------------------------------------------------------------
+void vtkMRMLTrackerStabilizerNode
+::SetMotionState( int state )
+{
+  if (this->MotionState == state)
+    {
+    return;
+    }
+  this->MotionState = state;
+  this->InvokeEvent(MotionStateModifiedEvent);
+}
+
+//-----------------------------------------------------------------------------
+void vtkMRMLTrackerStabilizerNode
+::SetFilterState( const double quaternion[4], const double position[3] )
+{
+  for (int i = 0; i < 4; i++)
+    {
+    this->FilterStateQuaternion[i] = quaternion[i];
+    }
+  for (int i = 0; i < 3; i++)
+    {
+    this->FilterStatePosition[i] = position[i];
+    }
+  this->FilterStateValid = true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkMRMLTrackerStabilizerNode
+::GetFilterState( double quaternion[4], double position[3] )
+{
+  if (!this->FilterStateValid)
+    {
+    return false;
+    }
+  for (int i = 0; i < 4; i++)
+    {
+    quaternion[i] = this->FilterStateQuaternion[i];
+    }
+  for (int i = 0; i < 3; i++)
+    {
+    position[i] = this->FilterStatePosition[i];
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void vtkMRMLTrackerStabilizerNode
+::ClearFilterState()
+{
+  this->FilterStateQuaternion[0] = 1.0;
+  this->FilterStateQuaternion[1] = 0.0;
+  this->FilterStateQuaternion[2] = 0.0;
+  this->FilterStateQuaternion[3] = 0.0;
+  this->FilterStatePosition[0] = 0.0;
+  this->FilterStatePosition[1] = 0.0;
+  this->FilterStatePosition[2] = 0.0;
+  this->FilterStateValid = false;
+}
+
+//-----------------------------------------------------------------------------
+const char* vtkMRMLTrackerStabilizerNode
+::GetCutOffFrameAsString( int frame )
+{
+  switch (frame)
+    {
+    case CutOffFrameCamera: return "Camera";
+    case CutOffFrameTool: return "Tool";
+    default:
+      break;
+    }
+  return "Unknown";
+}
+
+//-----------------------------------------------------------------------------
+int vtkMRMLTrackerStabilizerNode
+::GetCutOffFrameFromString( const char* name )
+{
+  if (name == NULL)
+    {
+    return -1;
+    }
+  for (int i = 0; i < CutOffFrame_Last; i++)
+    {
+    if (!strcmp(name, GetCutOffFrameAsString(i)))
+      {
+      return i;
+      }
+    }
+  return -1;
+}
+
+//-----------------------------------------------------------------------------
+const char* vtkMRMLTrackerStabilizerNode
+::GetWarmStartModeAsString( int mode )
+{
+  switch (mode)
+    {
+    case WarmStartFromInput: return "Input";
+    case WarmStartFromOutput: return "Output";
+    default:
+      break;
+    }
+  return "Unknown";
+}
+
+//-----------------------------------------------------------------------------
+int vtkMRMLTrackerStabilizerNode
+::GetWarmStartModeFromString( const char* name )
+{
+  if (name == NULL)
+    {
+    return -1;
+    }
+  for (int i = 0; i < WarmStartMode_Last; i++)
+    {
+    if (!strcmp(name, GetWarmStartModeAsString(i)))
+      {
+      return i;
+      }
+    }
+  return -1;
+}
+
+//-----------------------------------------------------------------------------
+void vtkMRMLTrackerStabilizerNode
+::GetEffectiveCutOffFrequencies( double cutoffs[4] )
+{
+  if (!this->SeparateCutOffFrequencies)
+    {
+    cutoffs[0] = cutoffs[1] = cutoffs[2] = cutoffs[3] = this->CutOffFrequency;
+    return;
+    }
+  cutoffs[0] = this->RotationCutOffFrequency;
+  cutoffs[1] = this->TranslationCutOffFrequency[0];
+  cutoffs[2] = this->TranslationCutOffFrequency[1];
+  cutoffs[3] = this->TranslationCutOffFrequency[2];
 }
 
 //-----------------------------------------------------------------------------
@@ -199,6 +704,67 @@ void vtkMRMLTrackerStabilizerNode
   this->InvokeEvent(InputDataModifiedEvent); // This will tell the logic to update
 }
 
+//-----------------------------------------------------------------------------
+vtkMRMLLinearTransformNode* vtkMRMLTrackerStabilizerNode
+::GetReferenceTransformNode()
+{
+  vtkMRMLLinearTransformNode* referenceNode = vtkMRMLLinearTransformNode::SafeDownCast(
+    this->GetNodeReference( REFERENCE_TRANSFORM_ROLE ) );
+  return referenceNode;
+}
+
+//-----------------------------------------------------------------------------
+void vtkMRMLTrackerStabilizerNode
+::SetAndObserveReferenceTransformNodeID( const char* referenceNodeId )
+{
+  // See SetAndObserveInputTransformNodeID
+  const char* currentNodeId = this->GetNodeReferenceID(REFERENCE_TRANSFORM_ROLE);
+  if (referenceNodeId != NULL && currentNodeId != NULL)
+    {
+    if (strcmp(referenceNodeId, currentNodeId) == 0)
+      {
+      // not changed
+      return;
+      }
+    }
+  vtkNew<vtkIntArray> events;
+  events->InsertNextValue( vtkCommand::ModifiedEvent );
+  this->SetAndObserveNodeReferenceID( REFERENCE_TRANSFORM_ROLE, referenceNodeId, events.GetPointer() );
+  this->InvokeEvent(InputDataModifiedEvent); // This will tell the logic to update
+}
+
+//-----------------------------------------------------------------------------
+vtkMRMLLinearTransformNode* vtkMRMLTrackerStabilizerNode
+::GetToolTipTransformNode()
+{
+  vtkMRMLLinearTransformNode* toolTipNode = vtkMRMLLinearTransformNode::SafeDownCast(
+    this->GetNodeReference( TOOLTIP_TRANSFORM_ROLE ) );
+  return toolTipNode;
+}
+
+//-----------------------------------------------------------------------------
+void vtkMRMLTrackerStabilizerNode
+::SetToolTipTransformNodeID( const char* toolTipNodeId )
+{
+  this->SetNodeReferenceID( TOOLTIP_TRANSFORM_ROLE, toolTipNodeId );
+}
+
+//-----------------------------------------------------------------------------
+vtkMRMLLinearTransformNode* vtkMRMLTrackerStabilizerNode
+::GetGroundTruthTransformNode()
+{
+  vtkMRMLLinearTransformNode* groundTruthNode = vtkMRMLLinearTransformNode::SafeDownCast(
+    this->GetNodeReference( GROUNDTRUTH_TRANSFORM_ROLE ) );
+  return groundTruthNode;
+}
+
+//-----------------------------------------------------------------------------
+void vtkMRMLTrackerStabilizerNode
+::SetGroundTruthTransformNodeID( const char* groundTruthNodeId )
+{
+  this->SetNodeReferenceID( GROUNDTRUTH_TRANSFORM_ROLE, groundTruthNodeId );
+}
+
 //-----------------------------------------------------------------------------
 void vtkMRMLTrackerStabilizerNode
 ::ProcessMRMLEvents( vtkObject *caller, unsigned long /*event*/, void* /*callData*/ )
@@ -214,4 +780,8 @@ void vtkMRMLTrackerStabilizerNode
     {
     this->InvokeEvent(InputDataModifiedEvent); // This will tell the logic to update
     }
+  else if (this->GetReferenceTransformNode() && this->GetReferenceTransformNode() == caller)
+    {
+    this->InvokeEvent(InputDataModifiedEvent); // This will tell the logic to update
+    }
 }
@@ -45,9 +45,46 @@ public:
   enum Events
   {
     // vtkCommand::UserEvent + 777 is just a random value that is very unlikely to be used for anything else in this class
-    InputDataModifiedEvent = vtkCommand::UserEvent + 777
+    InputDataModifiedEvent = vtkCommand::UserEvent + 777,
+    // Invoked instead of ModifiedEvent when the logic changes MotionState,
+    // so that state updates do not look like parameter changes
+    MotionStateModifiedEvent
   };
 
+  // Motion state of the tracked tool, as classified by the logic
+  enum MotionStates
+  {
+    MotionStationary = 0,
+    MotionSlow,
+    MotionFast,
+    MotionState_Last
+  };
+
+  static const char* GetMotionStateAsString( int state );
+
+  // Frame whose axes the translation cutoff frequencies apply to
+  enum CutOffFrames
+  {
+    CutOffFrameCamera = 0, // Parent frame of the input transform (tracker)
+    CutOffFrameTool,
+    CutOffFrame_Last
+  };
+
+  static const char* GetCutOffFrameAsString( int frame );
+  static int GetCutOffFrameFromString( const char* name );
+
+  // Pose the filter starts from when it is first run or when its input,
+  // output or reference node changes
+  enum WarmStartModes
+  {
+    WarmStartFromInput = 0, // No transient, the output starts at the input
+    WarmStartFromOutput,    // The output glides from its current pose
+    WarmStartMode_Last
+  };
+
+  static const char* GetWarmStartModeAsString( int mode );
+  static int GetWarmStartModeFromString( const char* name );
+
   vtkTypeMacro( vtkMRMLTrackerStabilizerNode, vtkMRMLNode);
 
   // Standard MRML node methods
@@ -78,19 +115,180 @@ public:
   vtkGetMacro( FilterActivated, bool );
   vtkSetMacro( FilterActivated, bool );
   vtkBooleanMacro( FilterActivated, bool );
-  
+
+  vtkGetMacro( WarmStartMode, int );
+  vtkSetClampMacro( WarmStartMode, int, WarmStartFromInput, WarmStartMode_Last - 1 );
+
+  // Separate cutoff frequencies for the rotation and for each translation
+  // axis, in the camera or tool frame. When SeparateCutOffFrequencies is off,
+  // CutOffFrequency applies to all of them.
+  vtkGetMacro( SeparateCutOffFrequencies, bool );
+  vtkSetMacro( SeparateCutOffFrequencies, bool );
+  vtkBooleanMacro( SeparateCutOffFrequencies, bool );
+
+  vtkGetMacro( RotationCutOffFrequency, double );
+  vtkSetMacro( RotationCutOffFrequency, double );
+
+  vtkGetVector3Macro( TranslationCutOffFrequency, double );
+  vtkSetVector3Macro( TranslationCutOffFrequency, double );
+
+  vtkGetMacro( TranslationCutOffFrame, int );
+  vtkSetClampMacro( TranslationCutOffFrame, int, CutOffFrameCamera, CutOffFrame_Last - 1 );
+
+  // Cutoff frequencies in use: rotation, then translation axes
+  void GetEffectiveCutOffFrequencies( double cutoffs[4] );
+
+  // Position of the tool tip in the tool frame (mm). Rotation jitter moves
+  // the tip by the lever arm times the angle, so when TargetToolTipJitter
+  // (RMS, mm) is not 0 the logic estimates the input noise and smooths both
+  // rotation and translation further until the expected tip jitter meets the
+  // target. The cutoff frequencies remain the least smoothing applied.
+  vtkGetVector3Macro( ToolTipOffset, double );
+  vtkSetVector3Macro( ToolTipOffset, double );
+
+  vtkGetMacro( TargetToolTipJitter, double );
+  vtkSetMacro( TargetToolTipJitter, double );
+
+  // When the output gets within these tolerances (mm, deg) of an input that
+  // no longer changes, it is snapped to the input and no longer published
+  // until the input is modified again.
+  vtkGetMacro( ConvergencePositionTolerance, double );
+  vtkSetMacro( ConvergencePositionTolerance, double );
+  vtkGetMacro( ConvergenceRotationTolerance, double );
+  vtkSetMacro( ConvergenceRotationTolerance, double );
+
+  // Motion detection: when enabled, the filter is relaxed while the tool moves
+  // (slow: cutoff scaled by SlowCutOffFrequencyScale, fast: no filtering) and
+  // restored when it stops. Speeds are in mm/s and deg/s. Hysteresis is the
+  // fraction below a threshold the speed must drop before leaving a state.
+  vtkGetMacro( MotionDetection, bool );
+  vtkSetMacro( MotionDetection, bool );
+  vtkBooleanMacro( MotionDetection, bool );
+
+  vtkGetMacro( SlowTranslationSpeed, double );
+  vtkSetMacro( SlowTranslationSpeed, double );
+  vtkGetMacro( FastTranslationSpeed, double );
+  vtkSetMacro( FastTranslationSpeed, double );
+
+  vtkGetMacro( SlowRotationSpeed, double );
+  vtkSetMacro( SlowRotationSpeed, double );
+  vtkGetMacro( FastRotationSpeed, double );
+  vtkSetMacro( FastRotationSpeed, double );
+
+  vtkGetMacro( MotionHysteresis, double );
+  vtkSetClampMacro( MotionHysteresis, double, 0.0, 1.0 );
+
+  vtkGetMacro( SlowCutOffFrequencyScale, double );
+  vtkSetMacro( SlowCutOffFrequencyScale, double );
+
+  // Time constant (s) of the transition between filter strengths
+  vtkGetMacro( MotionTransitionTime, double );
+  vtkSetMacro( MotionTransitionTime, double );
+
+  // Scheduling: when the logic runs late, nodes of higher priority are
+  // filtered and published first, and updates of lower priority nodes are
+  // postponed. MaximumUpdateRate (Hz) limits how often the output is
+  // updated, 0 (default) updates it for every input sample.
+  vtkGetMacro( Priority, int );
+  vtkSetMacro( Priority, int );
+  vtkGetMacro( MaximumUpdateRate, double );
+  vtkSetMacro( MaximumUpdateRate, double );
+
+  // Filters with the same non-zero GroupID track tools that move together
+  // (e.g. a reference frame and a tool mounted on it). Their common motion is
+  // filtered once, with the current weights of the first node by ID (motion
+  // detection and tool tip tuning included), and each node filters its
+  // offset from it with GroupOffsetCutOffFrequency.
+  // Offsets of rigidly mounted tools do not change, so they can be smoothed
+  // much more without lag, which keeps relative poses stable. Once an offset
+  // has converged it is not filtered anymore, until it moves again.
+  // A node whose reference differs from the first node's is filtered on its
+  // own.
+  // 0 (default) filters the node on its own.
+  vtkGetMacro( GroupID, int );
+  vtkSetMacro( GroupID, int );
+  vtkGetMacro( GroupOffsetCutOffFrequency, double );
+  vtkSetMacro( GroupOffsetCutOffFrequency, double );
+
+  // Current motion state (see MotionStates). Updated by the logic; a change
+  // invokes MotionStateModifiedEvent, not ModifiedEvent.
+  vtkGetMacro( MotionState, int );
+  void SetMotionState( int state );
+
+  // Warm filter state, saved with the scene when SaveFilterState is on so
+  // that the output does not jump when the scene is loaded again. The state
+  // is the last filtered pose (relative to the reference, if any); it is
+  // updated by the logic for every sample and does not invoke Modified.
+  vtkGetMacro( SaveFilterState, bool );
+  vtkSetMacro( SaveFilterState, bool );
+  vtkBooleanMacro( SaveFilterState, bool );
+
+  void SetFilterState( const double quaternion[4], const double position[3] );
+  bool GetFilterState( double quaternion[4], double position[3] );
+  void ClearFilterState();
+
   vtkMRMLLinearTransformNode* GetInputTransformNode();
   void SetAndObserveInputTransformNodeID( const char* inputNodeId );
 
   vtkMRMLLinearTransformNode* GetFilteredTransformNode();
   void SetAndObserveFilteredTransformNodeID( const char* filteredNodeId );  
 
+  // Optional reference (e.g. patient reference). When set, the pose of the
+  // input relative to the reference is filtered, then composed again with
+  // the current reference pose, so that reference motion is not delayed.
+  // Input and reference must be transforms to the same parent.
+  vtkMRMLLinearTransformNode* GetReferenceTransformNode();
+  void SetAndObserveReferenceTransformNodeID( const char* referenceNodeId );
+
+  // Optional output of the filtered tool tip pose (filtered pose translated
+  // by ToolTipOffset). The node is written, not observed.
+  vtkMRMLLinearTransformNode* GetToolTipTransformNode();
+  void SetToolTipTransformNodeID( const char* toolTipNodeId );
+
+  // Optional ground truth of the input (e.g. from a synthetic source or a
+  // replay), used by the logic to compute accuracy and lag metrics. The node
+  // is read, not observed.
+  vtkMRMLLinearTransformNode* GetGroundTruthTransformNode();
+  void SetGroundTruthTransformNodeID( const char* groundTruthNodeId );
+
   void ProcessMRMLEvents( vtkObject *caller, unsigned long event, void *callData );
 
 private:
   
   double CutOffFrequency;
   bool FilterActivated;
+  int WarmStartMode;
+
+  bool SeparateCutOffFrequencies;
+  double RotationCutOffFrequency;
+  double TranslationCutOffFrequency[3];
+  int TranslationCutOffFrame;
+
+  double ToolTipOffset[3];
+  double TargetToolTipJitter;
+
+  double ConvergencePositionTolerance;
+  double ConvergenceRotationTolerance;
+
+  bool MotionDetection;
+  double SlowTranslationSpeed;
+  double FastTranslationSpeed;
+  double SlowRotationSpeed;
+  double FastRotationSpeed;
+  double MotionHysteresis;
+  double SlowCutOffFrequencyScale;
+  double MotionTransitionTime;
+  int MotionState;
+
+  int Priority;
+  double MaximumUpdateRate;
+  int GroupID;
+  double GroupOffsetCutOffFrequency;
+
+  bool SaveFilterState;
+  bool FilterStateValid;
+  double FilterStateQuaternion[4];
+  double FilterStatePosition[3];
 
 };
 
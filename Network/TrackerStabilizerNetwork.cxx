@@ -0,0 +1,743 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+#include "TrackerStabilizerNetwork.h"
+
+// STD includes
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET SocketType;
+typedef int SocketLength;
+#define TS_INVALID_SOCKET INVALID_SOCKET
+#define TS_CLOSE_SOCKET closesocket
+#define TS_SEND_FLAGS 0
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int SocketType;
+typedef socklen_t SocketLength;
+#define TS_INVALID_SOCKET (-1)
+#define TS_CLOSE_SOCKET close
+#ifdef MSG_NOSIGNAL
+#define TS_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define TS_SEND_FLAGS 0
+#endif
+#endif
+
+namespace
+{
+const size_t HeaderSize = 20;
+const size_t PoseRecordSize = 32;
+const size_t MaximumFrameSize = 65507; // Largest UDP payload
+const uint8_t PoseFrameType = 1;
+const uint8_t ToolNamesFrameType = 2;
+const long long InvalidSocket = -1;
+
+//----------------------------------------------------------------------------
+bool InitializeSockets()
+{
+#ifdef _WIN32
+  static bool initialized = false;
+  if (!initialized)
+    {
+    WSADATA data;
+    initialized = (WSAStartup(MAKEWORD(2, 2), &data) == 0);
+    }
+  return initialized;
+#else
+  return true;
+#endif
+}
+
+//----------------------------------------------------------------------------
+SocketType ToSocket(long long socket)
+{
+  return (socket == InvalidSocket) ? TS_INVALID_SOCKET : static_cast<SocketType>(socket);
+}
+
+//----------------------------------------------------------------------------
+// Sends never wait for the receiver: they run on the filter tick
+bool SetNonBlocking(SocketType socket)
+{
+#ifdef _WIN32
+  u_long nonBlocking = 1;
+  return ioctlsocket(socket, FIONBIO, &nonBlocking) == 0;
+#else
+  const int flags = fcntl(socket, F_GETFL, 0);
+  return flags != -1 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+//----------------------------------------------------------------------------
+// True if the last send failed because the socket buffer is full
+bool SendWouldBlock()
+{
+#ifdef _WIN32
+  return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+  return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+//----------------------------------------------------------------------------
+void CloseSocket(long long& socket)
+{
+  if (socket != InvalidSocket)
+    {
+    TS_CLOSE_SOCKET(ToSocket(socket));
+    socket = InvalidSocket;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Little-endian encoding, independent of the host byte order
+
+void EncodeUInt16(std::vector<unsigned char>& buffer, uint16_t value)
+{
+  buffer.push_back(static_cast<unsigned char>(value & 0xff));
+  buffer.push_back(static_cast<unsigned char>(value >> 8));
+}
+
+void EncodeUInt32(std::vector<unsigned char>& buffer, uint32_t value)
+{
+  for (int i = 0; i < 4; ++i)
+    {
+    buffer.push_back(static_cast<unsigned char>((value >> (8*i)) & 0xff));
+    }
+}
+
+void EncodeFloat32(std::vector<unsigned char>& buffer, float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  EncodeUInt32(buffer, bits);
+}
+
+void EncodeFloat64(std::vector<unsigned char>& buffer, double value)
+{
+  uint32_t bits[2];
+  memcpy(bits, &value, sizeof(bits));
+  const uint16_t one = 1;
+  const bool littleEndianHost = (*reinterpret_cast<const unsigned char*>(&one) == 1);
+  EncodeUInt32(buffer, littleEndianHost ? bits[0] : bits[1]);
+  EncodeUInt32(buffer, littleEndianHost ? bits[1] : bits[0]);
+}
+
+uint16_t DecodeUInt16(const unsigned char* data)
+{
+  return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+uint32_t DecodeUInt32(const unsigned char* data)
+{
+  return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+    (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+float DecodeFloat32(const unsigned char* data)
+{
+  uint32_t bits = DecodeUInt32(data);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+double DecodeFloat64(const unsigned char* data)
+{
+  const uint16_t one = 1;
+  const bool littleEndianHost = (*reinterpret_cast<const unsigned char*>(&one) == 1);
+  uint32_t bits[2];
+  bits[littleEndianHost ? 0 : 1] = DecodeUInt32(data);
+  bits[littleEndianHost ? 1 : 0] = DecodeUInt32(data + 4);
+  double value;
+  memcpy(&value, bits, sizeof(value));
+  return value;
+}
+
+//----------------------------------------------------------------------------
+void EncodeHeader(std::vector<unsigned char>& buffer, uint8_t type, uint16_t count,
+                  uint32_t sequence, double timestamp)
+{
+  buffer.clear();
+  EncodeUInt32(buffer, TRACKERSTABILIZER_NET_MAGIC);
+  buffer.push_back(TRACKERSTABILIZER_NET_VERSION);
+  buffer.push_back(type);
+  EncodeUInt16(buffer, count);
+  EncodeUInt32(buffer, sequence);
+  EncodeFloat64(buffer, timestamp);
+}
+
+//----------------------------------------------------------------------------
+// Wait until the socket is readable. Returns false on timeout or error.
+bool WaitReadable(long long socket, int timeoutMilliseconds)
+{
+  fd_set readSet;
+  FD_ZERO(&readSet);
+  FD_SET(ToSocket(socket), &readSet);
+  timeval timeout;
+  timeout.tv_sec = timeoutMilliseconds / 1000;
+  timeout.tv_usec = (timeoutMilliseconds % 1000) * 1000;
+  return select(static_cast<int>(ToSocket(socket)) + 1, &readSet, NULL, NULL, &timeout) > 0;
+}
+
+//----------------------------------------------------------------------------
+bool ReceiveAll(long long socket, unsigned char* data, size_t size, int timeoutMilliseconds)
+{
+  size_t received = 0;
+  while (received < size)
+    {
+    if (!WaitReadable(socket, timeoutMilliseconds))
+      {
+      return false;
+      }
+    int count = recv(ToSocket(socket), reinterpret_cast<char*>(data + received),
+                     static_cast<int>(size - received), 0);
+    if (count <= 0)
+      {
+      return false;
+      }
+    received += static_cast<size_t>(count);
+    }
+  return true;
+}
+}
+
+//----------------------------------------------------------------------------
+// TrackerStabilizerNetworkSender
+
+//----------------------------------------------------------------------------
+TrackerStabilizerNetworkSender::TrackerStabilizerNetworkSender()
+  : Protocol(UDP)
+  , Socket(InvalidSocket)
+  , Sequence(0)
+  , ToolNamesModified(false)
+  , ToolNamesInterval(100)
+  , FramesSinceToolNames(0)
+  , NumberOfPoses(0)
+  , NumberOfDroppedFrames(0)
+{
+}
+
+//----------------------------------------------------------------------------
+TrackerStabilizerNetworkSender::~TrackerStabilizerNetworkSender()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+bool TrackerStabilizerNetworkSender::Open(int protocol, const char* host, int port)
+{
+  this->Close();
+  if (host == NULL || port <= 0 || port > 65535 || !InitializeSockets())
+    {
+    return false;
+    }
+
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = (protocol == TCP) ? SOCK_STREAM : SOCK_DGRAM;
+  char service[16];
+  snprintf(service, sizeof(service), "%d", port);
+  addrinfo* address = NULL;
+  if (getaddrinfo(host, service, &hints, &address) != 0 || address == NULL)
+    {
+    return false;
+    }
+
+  SocketType socket = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+  bool connected = false;
+  if (socket != TS_INVALID_SOCKET)
+    {
+    // Connecting a UDP socket fixes the destination of send()
+    connected = (connect(socket, address->ai_addr, static_cast<SocketLength>(address->ai_addrlen)) == 0);
+    if (connected && protocol == TCP)
+      {
+      // Frames are small and latency matters more than throughput
+      int noDelay = 1;
+      setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+      }
+    connected = connected && SetNonBlocking(socket);
+    if (!connected)
+      {
+      TS_CLOSE_SOCKET(socket);
+      }
+    }
+  freeaddrinfo(address);
+  if (!connected)
+    {
+    return false;
+    }
+
+  this->Protocol = protocol;
+  this->Socket = static_cast<long long>(socket);
+  this->Sequence = 0;
+  this->ToolNamesModified = !this->ToolNames.empty();
+  this->FramesSinceToolNames = 0;
+  this->NumberOfDroppedFrames = 0;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void TrackerStabilizerNetworkSender::Close()
+{
+  CloseSocket(this->Socket);
+  this->Unsent.clear();
+}
+
+//----------------------------------------------------------------------------
+bool TrackerStabilizerNetworkSender::IsOpen() const
+{
+  return this->Socket != InvalidSocket;
+}
+
+//----------------------------------------------------------------------------
+int TrackerStabilizerNetworkSender::FindOrAddTool(const char* toolName)
+{
+  std::string name = toolName ? toolName : "";
+  if (name.size() > 255)
+    {
+    name.resize(255);
+    }
+  for (size_t i = 0; i < this->ToolNames.size(); ++i)
+    {
+    if (this->ToolNames[i] == name)
+      {
+      return static_cast<int>(i);
+      }
+    }
+  this->ToolNames.push_back(name);
+  this->ToolNamesModified = true;
+  return static_cast<int>(this->ToolNames.size() - 1);
+}
+
+//----------------------------------------------------------------------------
+void TrackerStabilizerNetworkSender::BeginFrame(double timestamp)
+{
+  this->NumberOfPoses = 0;
+  this->Buffer.reserve(HeaderSize + 64 * PoseRecordSize);
+  EncodeHeader(this->Buffer, PoseFrameType, 0, this->Sequence, timestamp);
+}
+
+//----------------------------------------------------------------------------
+void TrackerStabilizerNetworkSender
+::AddPose(int tool, const double quaternion[4], const double position[3])
+{
+  if (tool < 0 || this->Buffer.size() + PoseRecordSize > MaximumFrameSize)
+    {
+    return;
+    }
+  EncodeUInt16(this->Buffer, static_cast<uint16_t>(tool));
+  EncodeUInt16(this->Buffer, 0);
+  for (int i = 0; i < 4; ++i)
+    {
+    EncodeFloat32(this->Buffer, static_cast<float>(quaternion[i]));
+    }
+  for (int i = 0; i < 3; ++i)
+    {
+    EncodeFloat32(this->Buffer, static_cast<float>(position[i]));
+    }
+  ++this->NumberOfPoses;
+}
+
+//----------------------------------------------------------------------------
+bool TrackerStabilizerNetworkSender::SendFrame()
+{
+  if (!this->IsOpen() || this->Buffer.size() < HeaderSize)
+    {
+    return false;
+    }
+
+  const double timestamp = DecodeFloat64(&this->Buffer[12]);
+  if (this->ToolNamesModified ||
+      (this->ToolNamesInterval > 0 && this->FramesSinceToolNames >= this->ToolNamesInterval))
+    {
+    // Encoded in its own buffer, the pose frame is already built
+    if (!this->SendToolNames(timestamp))
+      {
+      return false;
+      }
+    }
+  ++this->FramesSinceToolNames;
+
+  // Patch the pose count in the header
+  this->Buffer[6] = static_cast<unsigned char>(this->NumberOfPoses & 0xff);
+  this->Buffer[7] = static_cast<unsigned char>(this->NumberOfPoses >> 8);
+  ++this->Sequence;
+  return this->Send(this->Buffer);
+}
+
+//----------------------------------------------------------------------------
+bool TrackerStabilizerNetworkSender::SendToolNames(double timestamp)
+{
+  std::vector<unsigned char> buffer;
+  EncodeHeader(buffer, ToolNamesFrameType, 0, this->Sequence, timestamp);
+  uint16_t count = 0;
+  for (size_t i = 0; i < this->ToolNames.size(); ++i)
+    {
+    const std::string& name = this->ToolNames[i];
+    if (buffer.size() + 3 + name.size() > MaximumFrameSize)
+      {
+      break;
+      }
+    EncodeUInt16(buffer, static_cast<uint16_t>(i));
+    buffer.push_back(static_cast<unsigned char>(name.size()));
+    buffer.insert(buffer.end(), name.begin(), name.end());
+    ++count;
+    }
+  buffer[6] = static_cast<unsigned char>(count & 0xff);
+  buffer[7] = static_cast<unsigned char>(count >> 8);
+
+  // Sent again with the next frame if dropped
+  if (!this->Send(buffer))
+    {
+    return false;
+    }
+  this->ToolNamesModified = false;
+  this->FramesSinceToolNames = 0;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool TrackerStabilizerNetworkSender::Send(std::vector<unsigned char>& buffer)
+{
+  // The rest of a frame cut by a full socket buffer goes first, so that the
+  // stream stays delimited. While it does not go through, frames are dropped.
+  if (!this->Unsent.empty())
+    {
+    if (!this->Flush())
+      {
+      return false;
+      }
+    if (!this->Unsent.empty())
+      {
+      ++this->NumberOfDroppedFrames;
+      return false;
+      }
+    }
+
+  const unsigned char* data = &buffer[0];
+  size_t size = buffer.size();
+  std::vector<unsigned char> stream;
+  if (this->Protocol == TCP)
+    {
+    // Size prefix to delimit frames in the stream
+    stream.reserve(size + 4);
+    EncodeUInt32(stream, static_cast<uint32_t>(size));
+    stream.insert(stream.end(), buffer.begin(), buffer.end());
+    data = &stream[0];
+    size = stream.size();
+    }
+
+  size_t sent = 0;
+  while (sent < size)
+    {
+    int count = send(ToSocket(this->Socket), reinterpret_cast<const char*>(data + sent),
+                     static_cast<int>(size - sent), TS_SEND_FLAGS);
+    if (count <= 0)
+      {
+      if (count < 0 && SendWouldBlock())
+        {
+        if (sent == 0)
+          {
+          // The receiver does not keep up, drop the frame
+          ++this->NumberOfDroppedFrames;
+          return false;
+          }
+        // Only part of a TCP frame is in the stream, send the rest later
+        this->Unsent.assign(data + sent, data + size);
+        return true;
+        }
+      if (this->Protocol == TCP)
+        {
+        // The receiver went away
+        this->Close();
+        }
+      return false;
+      }
+    sent += static_cast<size_t>(count);
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool TrackerStabilizerNetworkSender::Flush()
+{
+  while (!this->Unsent.empty())
+    {
+    int count = send(ToSocket(this->Socket), reinterpret_cast<const char*>(&this->Unsent[0]),
+                     static_cast<int>(this->Unsent.size()), TS_SEND_FLAGS);
+    if (count <= 0)
+      {
+      if (count < 0 && SendWouldBlock())
+        {
+        return true;
+        }
+      this->Close();
+      return false;
+      }
+    this->Unsent.erase(this->Unsent.begin(), this->Unsent.begin() + count);
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// TrackerStabilizerNetworkReceiver
+
+//----------------------------------------------------------------------------
+TrackerStabilizerNetworkReceiver::TrackerStabilizerNetworkReceiver()
+  : Protocol(TrackerStabilizerNetworkSender::UDP)
+  , Port(0)
+  , Socket(InvalidSocket)
+  , Connection(InvalidSocket)
+{
+}
+
+//----------------------------------------------------------------------------
+TrackerStabilizerNetworkReceiver::~TrackerStabilizerNetworkReceiver()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+bool TrackerStabilizerNetworkReceiver::Open(int protocol, int port, const char* bindAddress)
+{
+  this->Close();
+  if (port < 0 || port > 65535 || !InitializeSockets())
+    {
+    return false;
+    }
+
+  const bool tcp = (protocol == TrackerStabilizerNetworkSender::TCP);
+  SocketType socket = ::socket(AF_INET, tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+  if (socket == TS_INVALID_SOCKET)
+    {
+    return false;
+    }
+  int reuse = 1;
+  setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(static_cast<unsigned short>(port));
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bindAddress != NULL)
+    {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    addrinfo* resolved = NULL;
+    if (getaddrinfo(bindAddress, NULL, &hints, &resolved) == 0 && resolved != NULL)
+      {
+      address.sin_addr = reinterpret_cast<sockaddr_in*>(resolved->ai_addr)->sin_addr;
+      freeaddrinfo(resolved);
+      }
+    }
+
+  SocketLength length = sizeof(address);
+  if (bind(socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      (tcp && listen(socket, 1) != 0) ||
+      getsockname(socket, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+    {
+    TS_CLOSE_SOCKET(socket);
+    return false;
+    }
+
+  this->Protocol = protocol;
+  this->Port = ntohs(address.sin_port);
+  this->Socket = static_cast<long long>(socket);
+  this->ToolNames.clear();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void TrackerStabilizerNetworkReceiver::Close()
+{
+  CloseSocket(this->Connection);
+  CloseSocket(this->Socket);
+  this->Port = 0;
+}
+
+//----------------------------------------------------------------------------
+bool TrackerStabilizerNetworkReceiver::IsOpen() const
+{
+  return this->Socket != InvalidSocket;
+}
+
+//----------------------------------------------------------------------------
+bool TrackerStabilizerNetworkReceiver
+::Receive(TrackerStabilizerNetworkFrame& frame, int timeoutMilliseconds)
+{
+  bool isPoseFrame = false;
+  while (this->ReceiveBuffer(timeoutMilliseconds))
+    {
+    if (this->Decode(frame, isPoseFrame) && isPoseFrame)
+      {
+      return true;
+      }
+    }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+std::string TrackerStabilizerNetworkReceiver::GetToolName(int tool) const
+{
+  if (tool < 0 || tool >= static_cast<int>(this->ToolNames.size()))
+    {
+    return std::string();
+    }
+  return this->ToolNames[tool];
+}
+
+//----------------------------------------------------------------------------
+bool TrackerStabilizerNetworkReceiver::ReceiveBuffer(int timeoutMilliseconds)
+{
+  if (!this->IsOpen())
+    {
+    return false;
+    }
+
+  if (this->Protocol != TrackerStabilizerNetworkSender::TCP)
+    {
+    if (!WaitReadable(this->Socket, timeoutMilliseconds))
+      {
+      return false;
+      }
+    this->Buffer.resize(MaximumFrameSize);
+    int count = recv(ToSocket(this->Socket), reinterpret_cast<char*>(&this->Buffer[0]),
+                     static_cast<int>(this->Buffer.size()), 0);
+    if (count <= 0)
+      {
+      return false;
+      }
+    this->Buffer.resize(static_cast<size_t>(count));
+    return true;
+    }
+
+  if (this->Connection == InvalidSocket)
+    {
+    if (!WaitReadable(this->Socket, timeoutMilliseconds))
+      {
+      return false;
+      }
+    SocketType connection = accept(ToSocket(this->Socket), NULL, NULL);
+    if (connection == TS_INVALID_SOCKET)
+      {
+      return false;
+      }
+    this->Connection = static_cast<long long>(connection);
+    }
+
+  unsigned char sizePrefix[4];
+  if (!ReceiveAll(this->Connection, sizePrefix, sizeof(sizePrefix), timeoutMilliseconds))
+    {
+    return false;
+    }
+  const uint32_t size = DecodeUInt32(sizePrefix);
+  if (size < HeaderSize || size > MaximumFrameSize)
+    {
+    // Lost synchronization with the sender
+    CloseSocket(this->Connection);
+    return false;
+    }
+  this->Buffer.resize(size);
+  if (!ReceiveAll(this->Connection, &this->Buffer[0], size, timeoutMilliseconds))
+    {
+    CloseSocket(this->Connection);
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool TrackerStabilizerNetworkReceiver
+::Decode(TrackerStabilizerNetworkFrame& frame, bool& isPoseFrame)
+{
+  const std::vector<unsigned char>& buffer = this->Buffer;
+  if (buffer.size() < HeaderSize ||
+      DecodeUInt32(&buffer[0]) != TRACKERSTABILIZER_NET_MAGIC ||
+      buffer[4] != TRACKERSTABILIZER_NET_VERSION)
+    {
+    return false;
+    }
+  const uint8_t type = buffer[5];
+  const uint16_t count = DecodeUInt16(&buffer[6]);
+
+  if (type == ToolNamesFrameType)
+    {
+    size_t offset = HeaderSize;
+    for (uint16_t i = 0; i < count && offset + 3 <= buffer.size(); ++i)
+      {
+      const uint16_t tool = DecodeUInt16(&buffer[offset]);
+      const size_t length = buffer[offset + 2];
+      offset += 3;
+      if (offset + length > buffer.size())
+        {
+        return false;
+        }
+      if (tool >= this->ToolNames.size())
+        {
+        this->ToolNames.resize(tool + 1);
+        }
+      this->ToolNames[tool].assign(reinterpret_cast<const char*>(&buffer[offset]), length);
+      offset += length;
+      }
+    isPoseFrame = false;
+    return true;
+    }
+
+  if (type != PoseFrameType || buffer.size() < HeaderSize + count * PoseRecordSize)
+    {
+    return false;
+    }
+  frame.Sequence = DecodeUInt32(&buffer[8]);
+  frame.Timestamp = DecodeFloat64(&buffer[12]);
+  frame.Poses.resize(count);
+  const unsigned char* record = &buffer[HeaderSize];
+  for (uint16_t i = 0; i < count; ++i, record += PoseRecordSize)
+    {
+    TrackerStabilizerNetworkPose& pose = frame.Poses[i];
+    pose.Tool = DecodeUInt16(record);
+    for (int j = 0; j < 4; ++j)
+      {
+      pose.Quaternion[j] = DecodeFloat32(record + 4 + 4*j);
+      }
+    for (int j = 0; j < 3; ++j)
+      {
+      pose.Position[j] = DecodeFloat32(record + 20 + 4*j);
+      }
+    }
+  isPoseFrame = true;
+  return true;
+}
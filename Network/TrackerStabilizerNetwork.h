@@ -0,0 +1,170 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// Network stream of filtered poses.
+//
+// All tools filtered in the same tick are sent in one frame. A frame is
+// little-endian and starts with a 20 byte header:
+//   uint32 magic ("TSP1"), uint8 version, uint8 type, uint16 count,
+//   uint32 sequence, float64 timestamp (s)
+// Pose frames are followed by count 32 byte records:
+//   uint16 tool, uint16 reserved, float32 quaternion[4] (w,x,y,z),
+//   float32 position[3] (mm)
+// Tool name frames map tool numbers to names and are followed by count
+// records: uint16 tool, uint8 length, char name[length]
+// They are sent when a tool is added and periodically, so that receivers
+// joining late learn the names.
+// Over UDP a frame is one datagram. Over TCP each frame is prefixed by its
+// size as a uint32.
+// Sending never blocks, as it runs on the filter tick: frames are dropped
+// while the receiver does not keep up.
+//
+// This library does not depend on VTK or Slicer so that external processes
+// can link it directly.
+
+#ifndef __TrackerStabilizerNetwork_h
+#define __TrackerStabilizerNetwork_h
+
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && _MSC_VER < 1600
+typedef unsigned __int8 uint8_t;
+typedef unsigned __int16 uint16_t;
+typedef unsigned __int32 uint32_t;
+#else
+#include <stdint.h>
+#endif
+
+#define TRACKERSTABILIZER_NET_MAGIC 0x31505354 // "TSP1" in little-endian order
+#define TRACKERSTABILIZER_NET_VERSION 1
+
+//----------------------------------------------------------------------------
+struct TrackerStabilizerNetworkPose
+{
+  int Tool;
+  float Quaternion[4];
+  float Position[3];
+};
+
+struct TrackerStabilizerNetworkFrame
+{
+  uint32_t Sequence;
+  double Timestamp;
+  std::vector<TrackerStabilizerNetworkPose> Poses;
+};
+
+//----------------------------------------------------------------------------
+class TrackerStabilizerNetworkSender
+{
+public:
+  enum Protocols
+  {
+    UDP = 0,
+    TCP
+  };
+
+  TrackerStabilizerNetworkSender();
+  ~TrackerStabilizerNetworkSender();
+
+  // Connect to the receiver. Returns false on failure.
+  bool Open(int protocol, const char* host, int port);
+  void Close();
+  bool IsOpen() const;
+
+  // Return the number of the tool with this name, adding it if needed
+  int FindOrAddTool(const char* toolName);
+
+  // Build and send one frame. Returns false if the frame was dropped or the
+  // connection lost (IsOpen is then false).
+  void BeginFrame(double timestamp);
+  void AddPose(int tool, const double quaternion[4], const double position[3]);
+  bool SendFrame();
+
+  // Send the end of a TCP frame cut by a full socket buffer, if any. It is
+  // also sent before the next frame. Returns false if the connection is lost.
+  bool Flush();
+
+  // Frames dropped because the socket buffer was full, since Open
+  unsigned int GetNumberOfDroppedFrames() const { return this->NumberOfDroppedFrames; }
+
+  // Number of pose frames between two repetitions of the tool names
+  void SetToolNamesInterval(unsigned int interval) { this->ToolNamesInterval = interval; }
+
+private:
+  TrackerStabilizerNetworkSender(const TrackerStabilizerNetworkSender&);
+  void operator=(const TrackerStabilizerNetworkSender&);
+
+  bool SendToolNames(double timestamp);
+  bool Send(std::vector<unsigned char>& buffer);
+
+  int Protocol;
+  long long Socket;
+  uint32_t Sequence;
+  std::vector<std::string> ToolNames;
+  bool ToolNamesModified;
+  unsigned int ToolNamesInterval;
+  unsigned int FramesSinceToolNames;
+  unsigned int NumberOfPoses;
+  unsigned int NumberOfDroppedFrames;
+  std::vector<unsigned char> Buffer;
+  // End of a TCP frame that did not fit in the socket buffer
+  std::vector<unsigned char> Unsent;
+};
+
+//----------------------------------------------------------------------------
+class TrackerStabilizerNetworkReceiver
+{
+public:
+  TrackerStabilizerNetworkReceiver();
+  ~TrackerStabilizerNetworkReceiver();
+
+  // Listen on a port (0 picks a free port, see GetPort). With TCP the first
+  // sender to connect is accepted by Receive.
+  bool Open(int protocol, int port, const char* bindAddress = "127.0.0.1");
+  void Close();
+  bool IsOpen() const;
+  int GetPort() const { return this->Port; }
+
+  // Wait up to timeout for the next pose frame. Tool name frames are
+  // consumed on the way. Returns false on timeout or error.
+  bool Receive(TrackerStabilizerNetworkFrame& frame, int timeoutMilliseconds);
+
+  // Name of a tool, empty if its name has not been received yet
+  std::string GetToolName(int tool) const;
+
+private:
+  TrackerStabilizerNetworkReceiver(const TrackerStabilizerNetworkReceiver&);
+  void operator=(const TrackerStabilizerNetworkReceiver&);
+
+  bool ReceiveBuffer(int timeoutMilliseconds);
+  bool Decode(TrackerStabilizerNetworkFrame& frame, bool& isPoseFrame);
+
+  int Protocol;
+  int Port;
+  long long Socket;
+  long long Connection;
+  std::vector<unsigned char> Buffer;
+  std::vector<std::string> ToolNames;
+};
+
+#endif
@@ -0,0 +1,460 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+#include "TrackerStabilizerSharedMemory.h"
+
+// STD includes
+#include <string.h>
+
+// The segment layout is shared with other processes: the atomics must be
+// lock-free and must not change the size of the fields they replace.
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "Shared memory requires lock-free 32-bit and 64-bit atomics");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) &&
+              sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+              "Shared memory requires atomics without overhead");
+static_assert(sizeof(TrackerStabilizerSharedMemoryHeader) == 64 &&
+              sizeof(TrackerStabilizerSharedMemoryTool) == 128 &&
+              sizeof(TrackerStabilizerSharedMemoryEntry) == 120,
+              "Unexpected shared memory layout");
+
+#if !defined(_WIN32)
+#define TRACKERSTABILIZER_HAS_SHM
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+//----------------------------------------------------------------------------
+// Number of attempts to read a pose that is being written before giving up
+const int MaximumReadAttempts = 64;
+
+//----------------------------------------------------------------------------
+size_t ToolStride(const TrackerStabilizerSharedMemoryHeader* header)
+{
+  return sizeof(TrackerStabilizerSharedMemoryTool) +
+    header->RingSize * sizeof(TrackerStabilizerSharedMemoryEntry);
+}
+
+//----------------------------------------------------------------------------
+size_t SegmentSize(unsigned int maximumNumberOfTools, unsigned int ringSize)
+{
+  return sizeof(TrackerStabilizerSharedMemoryHeader) + maximumNumberOfTools *
+    (sizeof(TrackerStabilizerSharedMemoryTool) + ringSize * sizeof(TrackerStabilizerSharedMemoryEntry));
+}
+
+//----------------------------------------------------------------------------
+TrackerStabilizerSharedMemoryTool* GetTool(const TrackerStabilizerSharedMemoryHeader* header, int tool)
+{
+  char* base = const_cast<char*>(reinterpret_cast<const char*>(header));
+  return reinterpret_cast<TrackerStabilizerSharedMemoryTool*>(
+    base + sizeof(TrackerStabilizerSharedMemoryHeader) + tool * ToolStride(header));
+}
+
+//----------------------------------------------------------------------------
+TrackerStabilizerSharedMemoryEntry* GetEntry(const TrackerStabilizerSharedMemoryHeader* header,
+                                             TrackerStabilizerSharedMemoryTool* tool, uint64_t index)
+{
+  TrackerStabilizerSharedMemoryEntry* ring = reinterpret_cast<TrackerStabilizerSharedMemoryEntry*>(tool + 1);
+  return ring + (index & (header->RingSize - 1));
+}
+
+//----------------------------------------------------------------------------
+// Segment names must start with a single slash
+void MakeSegmentName(const char* name, char* segmentName, size_t size)
+{
+  segmentName[0] = '/';
+  strncpy(segmentName + 1, (name[0] == '/') ? name + 1 : name, size - 2);
+  segmentName[size - 1] = '\0';
+}
+}
+
+//----------------------------------------------------------------------------
+// TrackerStabilizerSharedMemoryWriter
+
+//----------------------------------------------------------------------------
+TrackerStabilizerSharedMemoryWriter::TrackerStabilizerSharedMemoryWriter()
+  : Size(0)
+  , Header(NULL)
+{
+  this->SegmentName[0] = '\0';
+}
+
+//----------------------------------------------------------------------------
+TrackerStabilizerSharedMemoryWriter::~TrackerStabilizerSharedMemoryWriter()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+bool TrackerStabilizerSharedMemoryWriter
+::Create(const char* segmentName, unsigned int maximumNumberOfTools, unsigned int ringSize)
+{
+  this->Close();
+#ifdef TRACKERSTABILIZER_HAS_SHM
+  if (segmentName == NULL || segmentName[0] == '\0' || maximumNumberOfTools == 0)
+    {
+    return false;
+    }
+
+  unsigned int roundedRingSize = 1;
+  while (roundedRingSize < ringSize)
+    {
+    roundedRingSize <<= 1;
+    }
+
+  MakeSegmentName(segmentName, this->SegmentName, sizeof(this->SegmentName));
+  shm_unlink(this->SegmentName);
+  int fd = shm_open(this->SegmentName, O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd < 0)
+    {
+    return false;
+    }
+  size_t size = SegmentSize(maximumNumberOfTools, roundedRingSize);
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+    close(fd);
+    shm_unlink(this->SegmentName);
+    return false;
+    }
+  void* address = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED)
+    {
+    shm_unlink(this->SegmentName);
+    return false;
+    }
+
+  // The segment is zero-filled by ftruncate. Publish the magic number last
+  // so that readers never see a partially initialized header.
+  this->Size = size;
+  this->Header = static_cast<TrackerStabilizerSharedMemoryHeader*>(address);
+  this->Header->Version = TRACKERSTABILIZER_SHM_VERSION;
+  this->Header->MaximumNumberOfTools = maximumNumberOfTools;
+  this->Header->RingSize = roundedRingSize;
+  this->Header->NumberOfTools.store(0, std::memory_order_release);
+  this->Header->Magic.store(TRACKERSTABILIZER_SHM_MAGIC, std::memory_order_release);
+  return true;
+#else
+  (void)segmentName;
+  (void)maximumNumberOfTools;
+  (void)ringSize;
+  return false;
+#endif
+}
+
+//----------------------------------------------------------------------------
+void TrackerStabilizerSharedMemoryWriter::Close()
+{
+#ifdef TRACKERSTABILIZER_HAS_SHM
+  if (this->Header != NULL)
+    {
+    munmap(this->Header, this->Size);
+    shm_unlink(this->SegmentName);
+    }
+#endif
+  this->Header = NULL;
+  this->Size = 0;
+}
+
+//----------------------------------------------------------------------------
+int TrackerStabilizerSharedMemoryWriter::FindOrAddTool(const char* toolName)
+{
+#ifdef TRACKERSTABILIZER_HAS_SHM
+  if (this->Header == NULL || toolName == NULL)
+    {
+    return -1;
+    }
+  const int numberOfTools = static_cast<int>(this->Header->NumberOfTools.load(std::memory_order_relaxed));
+  for (int i = 0; i < numberOfTools; ++i)
+    {
+    if (strncmp(GetTool(this->Header, i)->Name, toolName, TRACKERSTABILIZER_SHM_NAME_LENGTH - 1) == 0)
+      {
+      return i;
+      }
+    }
+  if (numberOfTools >= static_cast<int>(this->Header->MaximumNumberOfTools))
+    {
+    return -1;
+    }
+
+  TrackerStabilizerSharedMemoryTool* tool = GetTool(this->Header, numberOfTools);
+  strncpy(tool->Name, toolName, TRACKERSTABILIZER_SHM_NAME_LENGTH - 1);
+  tool->Name[TRACKERSTABILIZER_SHM_NAME_LENGTH - 1] = '\0';
+  tool->WriteCount.store(0, std::memory_order_release);
+  this->Header->NumberOfTools.store(static_cast<uint32_t>(numberOfTools + 1), std::memory_order_release);
+  return numberOfTools;
+#else
+  (void)toolName;
+  return -1;
+#endif
+}
+
+//----------------------------------------------------------------------------
+void TrackerStabilizerSharedMemoryWriter::Write(int toolIndex, double timestamp, const double matrix[16])
+{
+#ifdef TRACKERSTABILIZER_HAS_SHM
+  if (this->Header == NULL || toolIndex < 0 ||
+      toolIndex >= static_cast<int>(this->Header->NumberOfTools.load(std::memory_order_relaxed)))
+    {
+    return;
+    }
+
+  TrackerStabilizerSharedMemoryTool* tool = GetTool(this->Header, toolIndex);
+  // Only modified by this writer
+  const uint64_t index = tool->WriteCount.load(std::memory_order_relaxed);
+  TrackerStabilizerSharedMemoryEntry* entry = GetEntry(this->Header, tool, index);
+
+  // Odd sequence: readers retry until the pose is complete
+  const uint32_t sequence = entry->Sequence.load(std::memory_order_relaxed);
+  entry->Sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  entry->Pose.Index = index;
+  entry->Pose.Timestamp = timestamp;
+  memcpy(entry->Pose.Matrix, matrix, sizeof(entry->Pose.Matrix));
+
+  entry->Sequence.store(sequence + 2, std::memory_order_release);
+  tool->WriteCount.store(index + 1, std::memory_order_release);
+#else
+  (void)toolIndex;
+  (void)timestamp;
+  (void)matrix;
+#endif
+}
+
+//----------------------------------------------------------------------------
+// TrackerStabilizerSharedMemoryReader
+
+//----------------------------------------------------------------------------
+TrackerStabilizerSharedMemoryReader::TrackerStabilizerSharedMemoryReader()
+  : Size(0)
+  , Header(NULL)
+{
+}
+
+//----------------------------------------------------------------------------
+TrackerStabilizerSharedMemoryReader::~TrackerStabilizerSharedMemoryReader()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+bool TrackerStabilizerSharedMemoryReader::Open(const char* segmentName)
+{
+  this->Close();
+#ifdef TRACKERSTABILIZER_HAS_SHM
+  if (segmentName == NULL || segmentName[0] == '\0')
+    {
+    return false;
+    }
+  char name[256];
+  MakeSegmentName(segmentName, name, sizeof(name));
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+    {
+    return false;
+    }
+  struct stat status;
+  if (fstat(fd, &status) != 0 ||
+      static_cast<size_t>(status.st_size) < sizeof(TrackerStabilizerSharedMemoryHeader))
+    {
+    close(fd);
+    return false;
+    }
+  size_t size = static_cast<size_t>(status.st_size);
+  void* address = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED)
+    {
+    return false;
+    }
+
+  const TrackerStabilizerSharedMemoryHeader* header =
+    static_cast<const TrackerStabilizerSharedMemoryHeader*>(address);
+  if (header->Magic.load(std::memory_order_acquire) != TRACKERSTABILIZER_SHM_MAGIC ||
+      header->Version != TRACKERSTABILIZER_SHM_VERSION ||
+      SegmentSize(header->MaximumNumberOfTools, header->RingSize) > size)
+    {
+    munmap(address, size);
+    return false;
+    }
+
+  this->Size = size;
+  this->Header = header;
+  return true;
+#else
+  (void)segmentName;
+  return false;
+#endif
+}
+
+//----------------------------------------------------------------------------
+void TrackerStabilizerSharedMemoryReader::Close()
+{
+#ifdef TRACKERSTABILIZER_HAS_SHM
+  if (this->Header != NULL)
+    {
+    munmap(const_cast<TrackerStabilizerSharedMemoryHeader*>(this->Header), this->Size);
+    }
+#endif
+  this->Header = NULL;
+  this->Size = 0;
+}
+
+//----------------------------------------------------------------------------
+int TrackerStabilizerSharedMemoryReader::GetNumberOfTools() const
+{
+#ifdef TRACKERSTABILIZER_HAS_SHM
+  if (this->Header == NULL)
+    {
+    return 0;
+    }
+  return static_cast<int>(this->Header->NumberOfTools.load(std::memory_order_acquire));
+#else
+  return 0;
+#endif
+}
+
+//----------------------------------------------------------------------------
+const char* TrackerStabilizerSharedMemoryReader::GetToolName(int tool) const
+{
+  if (tool < 0 || tool >= this->GetNumberOfTools())
+    {
+    return NULL;
+    }
+  return GetTool(this->Header, tool)->Name;
+}
+
+//----------------------------------------------------------------------------
+int TrackerStabilizerSharedMemoryReader::FindTool(const char* toolName) const
+{
+  if (toolName == NULL)
+    {
+    return -1;
+    }
+  const int numberOfTools = this->GetNumberOfTools();
+  for (int i = 0; i < numberOfTools; ++i)
+    {
+    if (strncmp(GetTool(this->Header, i)->Name, toolName, TRACKERSTABILIZER_SHM_NAME_LENGTH - 1) == 0)
+      {
+      return i;
+      }
+    }
+  return -1;
+}
+
+//----------------------------------------------------------------------------
+uint64_t TrackerStabilizerSharedMemoryReader::GetWriteCount(int tool) const
+{
+#ifdef TRACKERSTABILIZER_HAS_SHM
+  if (tool < 0 || tool >= this->GetNumberOfTools())
+    {
+    return 0;
+    }
+  return GetTool(this->Header, tool)->WriteCount.load(std::memory_order_acquire);
+#else
+  (void)tool;
+  return 0;
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool TrackerStabilizerSharedMemoryReader
+::ReadPose(int toolIndex, uint64_t index, TrackerStabilizerSharedMemoryPose& pose) const
+{
+#ifdef TRACKERSTABILIZER_HAS_SHM
+  TrackerStabilizerSharedMemoryTool* tool = GetTool(this->Header, toolIndex);
+  const TrackerStabilizerSharedMemoryEntry* source = GetEntry(this->Header, tool, index);
+  for (int attempt = 0; attempt < MaximumReadAttempts; ++attempt)
+    {
+    const uint32_t sequenceBefore = source->Sequence.load(std::memory_order_acquire);
+    if (sequenceBefore & 1)
+      {
+      continue; // Being written
+      }
+    memcpy(&pose, &source->Pose, sizeof(pose));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint32_t sequenceAfter = source->Sequence.load(std::memory_order_relaxed);
+    if (sequenceBefore == sequenceAfter)
+      {
+      // A different index means the writer has already reused the entry
+      return pose.Index == index;
+      }
+    }
+  return false;
+#else
+  (void)toolIndex;
+  (void)index;
+  (void)pose;
+  return false;
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool TrackerStabilizerSharedMemoryReader
+::ReadLatest(int tool, TrackerStabilizerSharedMemoryPose& pose) const
+{
+  for (int attempt = 0; attempt < MaximumReadAttempts; ++attempt)
+    {
+    const uint64_t writeCount = this->GetWriteCount(tool);
+    if (writeCount == 0)
+      {
+      return false;
+      }
+    if (this->ReadPose(tool, writeCount - 1, pose))
+      {
+      return true;
+      }
+    }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+bool TrackerStabilizerSharedMemoryReader
+::ReadNext(int tool, int64_t& cursor, TrackerStabilizerSharedMemoryPose& pose) const
+{
+  for (int attempt = 0; attempt < MaximumReadAttempts; ++attempt)
+    {
+    const uint64_t writeCount = this->GetWriteCount(tool);
+    const uint64_t ringSize = this->Header ? this->Header->RingSize : 0;
+    const uint64_t oldest = (writeCount > ringSize) ? writeCount - ringSize : 0;
+    uint64_t next = static_cast<uint64_t>(cursor + 1);
+    if (cursor < 0 || next < oldest)
+      {
+      next = oldest;
+      }
+    if (next >= writeCount)
+      {
+      return false;
+      }
+    if (this->ReadPose(tool, next, pose))
+      {
+      cursor = static_cast<int64_t>(next);
+      return true;
+      }
+    }
+  return false;
+}
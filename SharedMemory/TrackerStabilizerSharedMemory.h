@@ -0,0 +1,156 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// Shared memory channel for filtered poses.
+//
+// The segment (POSIX shared memory) starts with a header followed by one
+// slot per tool. Each slot holds a ring of timestamped poses. Every pose is
+// protected by a sequence lock: the writer makes the sequence odd while it
+// writes, so a reader retries instead of returning a torn pose, and neither
+// side ever blocks the other.
+//
+// The shared fields are std::atomic. Only 32-bit and 64-bit atomics that
+// are lock-free are used, so they are address-free and work across
+// processes that map the segment at different addresses.
+//
+// This library does not depend on VTK or Slicer so that external processes
+// can link it directly.
+
+#ifndef __TrackerStabilizerSharedMemory_h
+#define __TrackerStabilizerSharedMemory_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+// STD includes
+#include <atomic>
+
+#define TRACKERSTABILIZER_SHM_MAGIC 0x54534d31 // "TSM1"
+#define TRACKERSTABILIZER_SHM_VERSION 1
+#define TRACKERSTABILIZER_SHM_NAME_LENGTH 64
+
+//----------------------------------------------------------------------------
+// Segment layout. All offsets are fixed once the segment is created.
+
+struct TrackerStabilizerSharedMemoryHeader
+{
+  std::atomic<uint32_t> Magic;
+  uint32_t Version;
+  uint32_t MaximumNumberOfTools;
+  uint32_t RingSize;      // Number of poses per tool, power of two
+  std::atomic<uint32_t> NumberOfTools; // Published after the tool slot is initialized
+  uint32_t Padding[11];   // Keep slots on a cache line boundary
+};
+
+// Pose as returned to readers
+struct TrackerStabilizerSharedMemoryPose
+{
+  uint64_t Index;         // Number of poses written to the tool before this one
+  double Timestamp;       // Seconds (vtkTimerLog universal time)
+  double Matrix[12];      // Rows 0-2 of the 4x4 transform, row-major
+};
+
+// Ring entry: a pose protected by its sequence lock
+struct TrackerStabilizerSharedMemoryEntry
+{
+  std::atomic<uint32_t> Sequence; // Odd while the pose is being written
+  uint32_t Padding;
+  TrackerStabilizerSharedMemoryPose Pose;
+};
+
+struct TrackerStabilizerSharedMemoryTool
+{
+  char Name[TRACKERSTABILIZER_SHM_NAME_LENGTH];
+  std::atomic<uint64_t> WriteCount; // Number of poses written to the ring
+  uint64_t Padding[7];
+  // Followed by RingSize TrackerStabilizerSharedMemoryEntry
+};
+
+//----------------------------------------------------------------------------
+// Writer, used by the stabilizer logic. Creates and owns the segment.
+class TrackerStabilizerSharedMemoryWriter
+{
+public:
+  TrackerStabilizerSharedMemoryWriter();
+  ~TrackerStabilizerSharedMemoryWriter();
+
+  // Create (or replace) the segment. The ring size is rounded up to a power
+  // of two. Returns false if shared memory is not available.
+  bool Create(const char* segmentName, unsigned int maximumNumberOfTools, unsigned int ringSize);
+  void Close();
+  bool IsOpen() const { return this->Header != NULL; }
+
+  // Return the slot of the tool with this name, adding it if needed.
+  // Returns -1 when all slots are used.
+  int FindOrAddTool(const char* toolName);
+
+  // Append a pose to the ring of a tool. matrix is a row-major 4x4 matrix.
+  void Write(int tool, double timestamp, const double matrix[16]);
+
+private:
+  TrackerStabilizerSharedMemoryWriter(const TrackerStabilizerSharedMemoryWriter&);
+  void operator=(const TrackerStabilizerSharedMemoryWriter&);
+
+  char SegmentName[256];
+  size_t Size;
+  TrackerStabilizerSharedMemoryHeader* Header;
+};
+
+//----------------------------------------------------------------------------
+// Reader, for external processes. Maps the segment read-only.
+class TrackerStabilizerSharedMemoryReader
+{
+public:
+  TrackerStabilizerSharedMemoryReader();
+  ~TrackerStabilizerSharedMemoryReader();
+
+  bool Open(const char* segmentName);
+  void Close();
+  bool IsOpen() const { return this->Header != NULL; }
+
+  int GetNumberOfTools() const;
+  const char* GetToolName(int tool) const;
+  int FindTool(const char* toolName) const;
+
+  // Number of poses written so far for the tool. Cheap, can be polled.
+  uint64_t GetWriteCount(int tool) const;
+
+  // Copy the most recent pose of the tool. Returns false if there is none.
+  bool ReadLatest(int tool, TrackerStabilizerSharedMemoryPose& pose) const;
+
+  // Copy the pose that follows cursor (the Index of the last pose read, or
+  // -1 to start from the oldest pose still in the ring) and advance cursor.
+  // If the writer has lapped the reader, reading resumes at the oldest pose
+  // still available. Returns false when there is no new pose.
+  bool ReadNext(int tool, int64_t& cursor, TrackerStabilizerSharedMemoryPose& pose) const;
+
+private:
+  TrackerStabilizerSharedMemoryReader(const TrackerStabilizerSharedMemoryReader&);
+  void operator=(const TrackerStabilizerSharedMemoryReader&);
+
+  bool ReadPose(int tool, uint64_t index, TrackerStabilizerSharedMemoryPose& pose) const;
+
+  size_t Size;
+  const TrackerStabilizerSharedMemoryHeader* Header;
+};
+
+#endif
@@ -0,0 +1,269 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// TrackerStabilizer Network includes
+#include "TrackerStabilizerNetwork.h"
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+//-----------------------------------------------------------------------------
+// Pose sent for a tool in a frame
+void ExpectedPose(int frame, int tool, double quaternion[4], double position[3])
+{
+  const double angle = 0.1*frame + 0.5*tool;
+  quaternion[0] = cos(angle);
+  quaternion[1] = 0.0;
+  quaternion[2] = sin(angle);
+  quaternion[3] = 0.0;
+  position[0] = 10.0*frame;
+  position[1] = -20.0*tool;
+  position[2] = 1000.0 + frame + 0.25;
+}
+
+//-----------------------------------------------------------------------------
+// Send frames from a sender to a receiver listening on a free port of the
+// loopback interface, and check that the sequence numbers, poses and tool
+// names are received. A tool is added on the way.
+bool TestLoopback(int protocol, const char* protocolName)
+{
+  TrackerStabilizerNetworkReceiver receiver;
+  if (!receiver.Open(protocol, 0))
+    {
+    std::cerr << protocolName << ": cannot open the receiver" << std::endl;
+    return false;
+    }
+  if (receiver.GetPort() <= 0)
+    {
+    std::cerr << protocolName << ": no port assigned, got " << receiver.GetPort() << std::endl;
+    return false;
+    }
+
+  TrackerStabilizerNetworkSender sender;
+  if (!sender.Open(protocol, "127.0.0.1", receiver.GetPort()))
+    {
+    std::cerr << protocolName << ": cannot connect to port " << receiver.GetPort() << std::endl;
+    return false;
+    }
+  sender.SetToolNamesInterval(3);
+  const char* toolNames[3] = { "Stylus", "Reference", "Probe" };
+  int tools[3] = { sender.FindOrAddTool(toolNames[0]), sender.FindOrAddTool(toolNames[1]), -1 };
+  if (sender.FindOrAddTool(toolNames[0]) != tools[0] || tools[0] == tools[1])
+    {
+    std::cerr << protocolName << ": tool numbers not unique" << std::endl;
+    return false;
+    }
+
+  const int numberOfFrames = 10;
+  for (int frame = 0; frame < numberOfFrames; ++frame)
+    {
+    // The third tool joins at frame 5
+    const int numberOfTools = (frame < 5) ? 2 : 3;
+    if (frame == 5)
+      {
+      tools[2] = sender.FindOrAddTool(toolNames[2]);
+      }
+    sender.BeginFrame(0.5 + 0.015*frame);
+    for (int tool = 0; tool < numberOfTools; ++tool)
+      {
+      double quaternion[4];
+      double position[3];
+      ExpectedPose(frame, tool, quaternion, position);
+      sender.AddPose(tools[tool], quaternion, position);
+      }
+    if (!sender.SendFrame())
+      {
+      std::cerr << protocolName << ": cannot send frame " << frame << std::endl;
+      return false;
+      }
+
+    TrackerStabilizerNetworkFrame received;
+    if (!receiver.Receive(received, 2000))
+      {
+      std::cerr << protocolName << ": frame " << frame << " not received" << std::endl;
+      return false;
+      }
+    if (received.Sequence != static_cast<uint32_t>(frame))
+      {
+      std::cerr << protocolName << ": sequence " << received.Sequence
+                << " received, expected " << frame << std::endl;
+      return false;
+      }
+    if (fabs(received.Timestamp - (0.5 + 0.015*frame)) > 1e-12)
+      {
+      std::cerr << protocolName << ": timestamp " << received.Timestamp
+                << " received in frame " << frame << std::endl;
+      return false;
+      }
+    if (received.Poses.size() != static_cast<size_t>(numberOfTools))
+      {
+      std::cerr << protocolName << ": " << received.Poses.size() << " poses received in frame "
+                << frame << ", expected " << numberOfTools << std::endl;
+      return false;
+      }
+    for (int tool = 0; tool < numberOfTools; ++tool)
+      {
+      const TrackerStabilizerNetworkPose& pose = received.Poses[tool];
+      double quaternion[4];
+      double position[3];
+      ExpectedPose(frame, tool, quaternion, position);
+      bool equal = (pose.Tool == tools[tool]);
+      for (int i = 0; i < 4; ++i)
+        {
+        equal = equal && fabs(pose.Quaternion[i] - quaternion[i]) <= 1e-6;
+        }
+      for (int i = 0; i < 3; ++i)
+        {
+        // Float precision of positions up to about 1 m
+        equal = equal && fabs(pose.Position[i] - position[i]) <= 1e-4;
+        }
+      if (!equal)
+        {
+        std::cerr << protocolName << ": pose " << tool << " of frame " << frame
+                  << " does not match what was sent" << std::endl;
+        return false;
+        }
+      if (receiver.GetToolName(pose.Tool) != toolNames[tool])
+        {
+        std::cerr << protocolName << ": tool " << pose.Tool << " received as \""
+                  << receiver.GetToolName(pose.Tool) << "\", expected \"" << toolNames[tool]
+                  << "\"" << std::endl;
+        return false;
+        }
+      }
+    }
+
+  // Nothing more was sent
+  TrackerStabilizerNetworkFrame received;
+  if (receiver.Receive(received, 100))
+    {
+    std::cerr << protocolName << ": unexpected frame " << received.Sequence << std::endl;
+    return false;
+    }
+
+  sender.Close();
+  receiver.Close();
+  if (sender.IsOpen() || receiver.IsOpen())
+    {
+    std::cerr << protocolName << ": not closed" << std::endl;
+    return false;
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+// A TCP receiver that does not read must not block the sender: frames that
+// do not fit in the socket buffer are dropped, and the stream stays
+// delimited so that the frames sent are received once the receiver reads.
+bool TestSlowReceiver()
+{
+  TrackerStabilizerNetworkReceiver receiver;
+  TrackerStabilizerNetworkSender sender;
+  if (!receiver.Open(TrackerStabilizerNetworkSender::TCP, 0) ||
+      !sender.Open(TrackerStabilizerNetworkSender::TCP, "127.0.0.1", receiver.GetPort()))
+    {
+    std::cerr << "Slow receiver: cannot connect" << std::endl;
+    return false;
+    }
+  const int tool = sender.FindOrAddTool("Stylus");
+
+  // About 2 KB per frame, far more than the socket buffers in total
+  const int numberOfFrames = 20000;
+  const int posesPerFrame = 64;
+  int numberOfSentFrames = 0;
+  for (int frame = 0; frame < numberOfFrames; ++frame)
+    {
+    sender.BeginFrame(0.015*frame);
+    for (int i = 0; i < posesPerFrame; ++i)
+      {
+      double quaternion[4];
+      double position[3];
+      ExpectedPose(frame, 0, quaternion, position);
+      sender.AddPose(tool, quaternion, position);
+      }
+    if (sender.SendFrame())
+      {
+      ++numberOfSentFrames;
+      }
+    }
+  if (!sender.IsOpen() || sender.GetNumberOfDroppedFrames() == 0 || numberOfSentFrames == 0)
+    {
+    std::cerr << "Slow receiver: " << numberOfSentFrames << " frames sent and "
+              << sender.GetNumberOfDroppedFrames() << " dropped, connection "
+              << (sender.IsOpen() ? "open" : "closed") << std::endl;
+    return false;
+    }
+
+  // Read everything that was sent, the end of a cut frame included, then
+  // new frames go through again
+  TrackerStabilizerNetworkFrame received;
+  uint32_t lastSequence = 0;
+  int numberOfReceivedFrames = 0;
+  while (sender.Flush() && receiver.Receive(received, 200))
+    {
+    if (received.Poses.size() != static_cast<size_t>(posesPerFrame) ||
+        (numberOfReceivedFrames > 0 && received.Sequence <= lastSequence))
+      {
+      std::cerr << "Slow receiver: frame " << received.Sequence << " corrupted" << std::endl;
+      return false;
+      }
+    lastSequence = received.Sequence;
+    ++numberOfReceivedFrames;
+    }
+  if (numberOfReceivedFrames != numberOfSentFrames)
+    {
+    std::cerr << "Slow receiver: " << numberOfReceivedFrames << " frames received, "
+              << numberOfSentFrames << " sent" << std::endl;
+    return false;
+    }
+  double quaternion[4];
+  double position[3];
+  ExpectedPose(0, 0, quaternion, position);
+  sender.BeginFrame(0.0);
+  sender.AddPose(tool, quaternion, position);
+  if (!sender.SendFrame() || !receiver.Receive(received, 2000) || received.Poses.size() != 1)
+    {
+    std::cerr << "Slow receiver: sending did not resume" << std::endl;
+    return false;
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//-----------------------------------------------------------------------------
+int TrackerStabilizerNetworkLoopbackTest(int, char*[])
+{
+  if (!TestLoopback(TrackerStabilizerNetworkSender::UDP, "UDP") ||
+      !TestLoopback(TrackerStabilizerNetworkSender::TCP, "TCP") ||
+      !TestSlowReceiver())
+    {
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
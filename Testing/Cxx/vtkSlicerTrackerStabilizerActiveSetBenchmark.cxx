@@ -0,0 +1,133 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// Benchmark of FilterActiveNodes on a large scene: a number of filter nodes
+// (10000 by default) of which only some are active, each with its own input
+// and output transforms. Reports the time per tick when all the active
+// inputs move and when they are idle, and the time to handle a parameter
+// change of one node.
+//
+// Usage: vtkSlicerTrackerStabilizerActiveSetBenchmark [numberOfNodes [numberOfActiveNodes [numberOfTicks]]]
+
+// TrackerStabilizer Logic includes
+#include "vtkSlicerTrackerStabilizerLogic.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLTrackerStabilizerNode.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  const int numberOfNodes = (argc > 1) ? atoi(argv[1]) : 10000;
+  const int numberOfActiveNodes = (argc > 2) ? atoi(argv[2]) : numberOfNodes / 100;
+  const int numberOfTicks = (argc > 3) ? atoi(argv[3]) : 1000;
+  if (numberOfNodes < 1 || numberOfActiveNodes < 1 || numberOfActiveNodes > numberOfNodes ||
+      numberOfTicks < 1)
+    {
+    std::cerr << "Usage: " << argv[0]
+              << " [numberOfNodes [numberOfActiveNodes [numberOfTicks]]]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkNew<vtkMRMLScene> scene;
+  vtkNew<vtkSlicerTrackerStabilizerLogic> logic;
+  logic->SetMRMLScene(scene.GetPointer());
+
+  // Inactive nodes have an input but no output
+  std::vector<vtkSmartPointer<vtkMRMLTrackerStabilizerNode> > tsNodes;
+  std::vector<vtkSmartPointer<vtkMRMLLinearTransformNode> > inputNodes;
+  for (int i = 0; i < numberOfNodes; ++i)
+    {
+    vtkSmartPointer<vtkMRMLLinearTransformNode> inputNode =
+      vtkSmartPointer<vtkMRMLLinearTransformNode>::New();
+    scene->AddNode(inputNode);
+    vtkSmartPointer<vtkMRMLTrackerStabilizerNode> tsNode =
+      vtkSmartPointer<vtkMRMLTrackerStabilizerNode>::New();
+    scene->AddNode(tsNode);
+    tsNode->SetAndObserveInputTransformNodeID(inputNode->GetID());
+    if (i < numberOfActiveNodes)
+      {
+      vtkSmartPointer<vtkMRMLLinearTransformNode> outputNode =
+        vtkSmartPointer<vtkMRMLLinearTransformNode>::New();
+      scene->AddNode(outputNode);
+      tsNode->SetAndObserveFilteredTransformNodeID(outputNode->GetID());
+      inputNodes.push_back(inputNode);
+      }
+    tsNodes.push_back(tsNode);
+    }
+  std::cout << "Nodes: " << numberOfNodes << ", active: "
+            << logic->GetNumberOfActiveFilters() << std::endl;
+
+  // All active inputs move every tick
+  vtkNew<vtkMatrix4x4> matrix;
+  double start = vtkTimerLog::GetUniversalTime();
+  for (int tick = 0; tick < numberOfTicks; ++tick)
+    {
+    matrix->SetElement(0, 3, tick % 100);
+    for (size_t i = 0; i < inputNodes.size(); ++i)
+      {
+      inputNodes[i]->SetMatrixTransformToParent(matrix.GetPointer());
+      }
+    logic->FilterActiveNodes();
+    }
+  const double movingTime = (vtkTimerLog::GetUniversalTime() - start) / numberOfTicks;
+
+  // Inputs idle, once the outputs have converged
+  for (int tick = 0; tick < 1000; ++tick)
+    {
+    logic->FilterActiveNodes();
+    }
+  start = vtkTimerLog::GetUniversalTime();
+  for (int tick = 0; tick < numberOfTicks; ++tick)
+    {
+    logic->FilterActiveNodes();
+    }
+  const double idleTime = (vtkTimerLog::GetUniversalTime() - start) / numberOfTicks;
+
+  // Parameter change of one node, then the tick that configures it again
+  start = vtkTimerLog::GetUniversalTime();
+  for (int tick = 0; tick < numberOfTicks; ++tick)
+    {
+    tsNodes[tick % numberOfActiveNodes]->SetCutOffFrequency(5.0 + tick % 2);
+    logic->FilterActiveNodes();
+    }
+  const double modifiedTime = (vtkTimerLog::GetUniversalTime() - start) / numberOfTicks;
+
+  std::cout << "Tick, inputs moving: " << movingTime*1e6 << " us" << std::endl;
+  std::cout << "Tick, inputs idle: " << idleTime*1e6 << " us" << std::endl;
+  std::cout << "Tick after a parameter change: " << modifiedTime*1e6 << " us" << std::endl;
+  return EXIT_SUCCESS;
+}
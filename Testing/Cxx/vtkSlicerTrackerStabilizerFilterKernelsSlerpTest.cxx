@@ -0,0 +1,214 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// TrackerStabilizer Logic includes
+#include "vtkSlicerTrackerStabilizerFilterKernels.h"
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace Kernels = vtkSlicerTrackerStabilizerFilterKernels;
+
+namespace
+{
+
+const double Pi = 3.14159265358979323846;
+
+//-----------------------------------------------------------------------------
+// Slerp in extended precision, without linear fallback
+void ReferenceSlerp(double result[4], double t, const double from[4], const double to[4])
+{
+  long double cosom = 0.0L;
+  for (int i = 0; i < 4; ++i)
+    {
+    cosom += static_cast<long double>(from[i])*to[i];
+    }
+  const long double sign = (cosom < 0.0L) ? -1.0L : 1.0L;
+  cosom = std::min(sign*cosom, 1.0L);
+  const long double omega = acosl(cosom);
+  long double sclp = 1.0L - t;
+  long double sclq = t;
+  if (omega > 0.0L)
+    {
+    sclp = sinl((1.0L - t)*omega) / sinl(omega);
+    sclq = sinl(t*omega) / sinl(omega);
+    }
+  for (int i = 0; i < 4; ++i)
+    {
+    result[i] = static_cast<double>(sclp*from[i] + sign*sclq*to[i]);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Rotation by angle about a unit axis
+void AxisAngleToQuaternion(const double axis[3], double angle, double quaternion[4])
+{
+  quaternion[0] = cos(0.5*angle);
+  for (int i = 0; i < 3; ++i)
+    {
+    quaternion[i + 1] = sin(0.5*angle)*axis[i];
+    }
+}
+
+//-----------------------------------------------------------------------------
+void MultiplyQuaternions(const double a[4], const double b[4], double result[4])
+{
+  result[0] = a[0]*b[0] - a[1]*b[1] - a[2]*b[2] - a[3]*b[3];
+  result[1] = a[0]*b[1] + a[1]*b[0] + a[2]*b[3] - a[3]*b[2];
+  result[2] = a[0]*b[2] - a[1]*b[3] + a[2]*b[0] + a[3]*b[1];
+  result[3] = a[0]*b[3] + a[1]*b[2] - a[2]*b[1] + a[3]*b[0];
+}
+
+//-----------------------------------------------------------------------------
+double Distance(const double a[4], const double b[4])
+{
+  double distance2 = 0.0;
+  for (int i = 0; i < 4; ++i)
+    {
+    distance2 += (a[i] - b[i])*(a[i] - b[i]);
+    }
+  return sqrt(distance2);
+}
+
+//-----------------------------------------------------------------------------
+// Rotation angles between the interpolated quaternions: a uniform grid up to
+// pi, angles approaching pi and going past it (the shortest path then goes
+// the other way), and very small angles
+std::vector<double> TestAngles()
+{
+  std::vector<double> angles;
+  const int numberOfAngles = 2000;
+  for (int k = 0; k <= numberOfAngles; ++k)
+    {
+    angles.push_back(Pi * k / numberOfAngles);
+    }
+  for (double epsilon = 1e-1; epsilon > 1e-13; epsilon /= 10.0)
+    {
+    angles.push_back(Pi - epsilon);
+    angles.push_back(Pi + epsilon);
+    angles.push_back(epsilon);
+    }
+  return angles;
+}
+
+} // end of anonymous namespace
+
+//-----------------------------------------------------------------------------
+// FastSlerp against Slerp on a dense grid of weights and angles, for every
+// number of terms. The number of terms selected for a tolerance, on a
+// coarser grid, must meet it on the dense grid.
+int vtkSlicerTrackerStabilizerFilterKernelsSlerpTest(int, char*[])
+{
+  const int numberOfWeights = 129;
+  const std::vector<double> angles = TestAngles();
+
+  // Start and axis of the rotation vary with the angle
+  const double startAxis[3] = {0.0, 0.6, 0.8};
+  const double rotationAxes[3][3] = { {1.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.48, 0.6, 0.64} };
+
+  double maximumSlerpError = 0.0;
+  double errors[Kernels::MaximumNumberOfSlerpTerms + 1];
+  for (int numberOfTerms = 0; numberOfTerms <= Kernels::MaximumNumberOfSlerpTerms; ++numberOfTerms)
+    {
+    errors[numberOfTerms] = 0.0;
+    }
+  for (int j = 0; j < numberOfWeights; ++j)
+    {
+    const double t = static_cast<double>(j) / (numberOfWeights - 1);
+    Kernels::SlerpCoefficients<double> coefficients[Kernels::MaximumNumberOfSlerpTerms + 1];
+    for (int numberOfTerms = 0; numberOfTerms <= Kernels::MaximumNumberOfSlerpTerms; ++numberOfTerms)
+      {
+      coefficients[numberOfTerms].Set(t, numberOfTerms);
+      }
+    for (size_t k = 0; k < angles.size(); ++k)
+      {
+      double from[4];
+      double rotation[4];
+      double to[4];
+      AxisAngleToQuaternion(startAxis, 0.3*k, from);
+      AxisAngleToQuaternion(rotationAxes[k % 3], angles[k], rotation);
+      MultiplyQuaternions(from, rotation, to);
+
+      double reference[4];
+      double exact[4];
+      ReferenceSlerp(reference, t, from, to);
+      Kernels::Slerp(exact, t, from, to);
+      maximumSlerpError = std::max(maximumSlerpError, Distance(exact, reference));
+      for (int numberOfTerms = 0; numberOfTerms <= Kernels::MaximumNumberOfSlerpTerms; ++numberOfTerms)
+        {
+        double approximate[4];
+        Kernels::FastSlerp(approximate, coefficients[numberOfTerms], from, to);
+        errors[numberOfTerms] = std::max(errors[numberOfTerms], Distance(approximate, exact));
+        }
+      }
+    }
+
+  bool success = true;
+  if (maximumSlerpError > 1e-12)
+    {
+    std::cerr << "Slerp is " << maximumSlerpError << " away from the exact slerp" << std::endl;
+    success = false;
+    }
+
+  // More terms are more accurate, except that one term is worse than nlerp
+  for (int numberOfTerms = 2; numberOfTerms <= Kernels::MaximumNumberOfSlerpTerms; ++numberOfTerms)
+    {
+    if (errors[numberOfTerms] >= errors[numberOfTerms - 1])
+      {
+      std::cerr << "Error with " << numberOfTerms << " terms (" << errors[numberOfTerms]
+                << ") not below the error with one term less" << std::endl;
+      success = false;
+      }
+    }
+
+  for (double tolerance = 1e-1; tolerance > 1e-12; tolerance /= 10.0)
+    {
+    const int numberOfTerms = Kernels::SelectNumberOfSlerpTerms(tolerance);
+    if (numberOfTerms >= 0 && errors[numberOfTerms] > tolerance)
+      {
+      std::cerr << numberOfTerms << " terms selected for a tolerance of " << tolerance
+                << ", but the error reaches " << errors[numberOfTerms] << std::endl;
+      success = false;
+      }
+    if (numberOfTerms < 0 && errors[Kernels::MaximumNumberOfSlerpTerms] <= tolerance)
+      {
+      std::cerr << "No number of terms selected for a tolerance of " << tolerance << ", but "
+                << Kernels::MaximumNumberOfSlerpTerms << " terms meet it" << std::endl;
+      success = false;
+      }
+    }
+
+  if (!success)
+    {
+    std::cerr << "Largest distance between FastSlerp and Slerp:" << std::endl;
+    for (int numberOfTerms = 0; numberOfTerms <= Kernels::MaximumNumberOfSlerpTerms; ++numberOfTerms)
+      {
+      std::cerr << "  " << numberOfTerms << " terms: " << errors[numberOfTerms] << std::endl;
+      }
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,298 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// TrackerStabilizer Logic includes
+#include "vtkSlicerTrackerStabilizerFilterKernels.h"
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace Kernels = vtkSlicerTrackerStabilizerFilterKernels;
+
+namespace
+{
+
+const double Pi = 3.14159265358979323846;
+
+// Same as the logic: 15 ms time step, quaternion renormalized every
+// Kernels::NormalizationInterval steps in double precision and every step in
+// single precision, node default convergence tolerances (0.01 mm, 0.01 deg)
+const double TimeStep = 0.015;
+const double PositionTolerance2 = 0.01*0.01;
+const double DotTolerance = 1.0 - cos(0.5*0.01*3.14159265358979323846/180.0);
+
+// The input repeats every period, so that once the filter has settled its
+// state must repeat too; any difference between periods is drift. The tool
+// stops at the end of each period, long enough for the filter to converge
+// and snap to the input.
+const int StepsPerPeriod = 4000;
+const int StationarySteps = 800;
+const int SettlingPeriods = 2;
+
+// Once in a while the filter is turned off for a few steps: the state then
+// follows the input, as in the pass-through filter of the logic
+const int PassThroughPeriodInterval = 64;
+const int PassThroughSteps = 50;
+
+//-----------------------------------------------------------------------------
+// Deterministic noise in [-1, 1], the same on all platforms
+double Noise(unsigned int& seed)
+{
+  seed = seed*1664525u + 1013904223u;
+  return (seed >> 8) / 8388607.5 - 1.0;
+}
+
+//-----------------------------------------------------------------------------
+// One period of input poses: rotation of up to 170 degrees about an axis
+// that turns, a 100 mm circle, and noise of about 0.5 degree and 0.2 mm,
+// then a still pose without noise. Every 7th quaternion has the opposite
+// sign (same rotation), as trackers may report.
+void MakeInputPeriod(std::vector<double>& quaternions, std::vector<double>& positions)
+{
+  quaternions.resize(4*StepsPerPeriod);
+  positions.resize(3*StepsPerPeriod);
+  unsigned int seed = 12345u;
+  const int movingSteps = StepsPerPeriod - StationarySteps;
+  for (int k = 0; k < StepsPerPeriod; ++k)
+    {
+    double* quaternion = &quaternions[4*k];
+    double* position = &positions[3*k];
+    if (k >= movingSteps)
+      {
+      for (int i = 0; i < 4; ++i)
+        {
+        quaternion[i] = quaternions[4*(movingSteps - 1) + i];
+        }
+      for (int i = 0; i < 3; ++i)
+        {
+        position[i] = positions[3*(movingSteps - 1) + i];
+        }
+      if (k % 7 == 0)
+        {
+        for (int i = 0; i < 4; ++i)
+          {
+          quaternion[i] = -quaternion[i];
+          }
+        }
+      continue;
+      }
+    const double phase = 2.0*Pi*k / movingSteps;
+    const double angle = 170.0*Pi/180.0*sin(phase) + 0.01*Noise(seed);
+    double axis[3] = { cos(phase), sin(phase), 0.5 + 0.01*Noise(seed) };
+    const double norm = sqrt(axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2]);
+    const double sign = (k % 7 == 0) ? -1.0 : 1.0;
+    quaternion[0] = sign*cos(0.5*angle);
+    for (int i = 0; i < 3; ++i)
+      {
+      quaternion[i + 1] = sign*sin(0.5*angle)*axis[i] / norm;
+      }
+    position[0] = 100.0*cos(phase) + 0.2*Noise(seed);
+    position[1] = 100.0*sin(phase) + 0.2*Noise(seed);
+    position[2] = -1500.0 + 0.2*Noise(seed);
+    }
+}
+
+//-----------------------------------------------------------------------------
+template <typename Real>
+double QuaternionDistance(const Real a[4], const Real b[4])
+{
+  double distance2 = 0.0;
+  for (int i = 0; i < 4; ++i)
+    {
+    distance2 += (static_cast<double>(a[i]) - b[i])*(static_cast<double>(a[i]) - b[i]);
+    }
+  return sqrt(distance2);
+}
+
+//-----------------------------------------------------------------------------
+// Step one filter numberOfSteps times over the repeated input, with the
+// per-sample state handling of the logic: periodic renormalization, snap to
+// the input once converged, and input followed in the hemisphere of the
+// state while the filter is off. Checks at every step that the quaternion
+// stays normalized and in the hemisphere of the previous step, that the
+// filter converges when the tool stops, and at the end of the motion of
+// every period that the state is within the drift bounds of the state at the
+// same point of the last settling period.
+template <typename Real, class Algorithm>
+bool Soak(const char* name, long long numberOfSteps, int numberOfSlerpTerms,
+          unsigned int normalizationInterval, double normTolerance,
+          double quaternionDriftTolerance, double positionDriftTolerance)
+{
+  std::vector<double> inputQuaternions;
+  std::vector<double> inputPositions;
+  MakeInputPeriod(inputQuaternions, inputPositions);
+  std::vector<Real> periodQuaternions(inputQuaternions.begin(), inputQuaternions.end());
+  std::vector<Real> periodPositions(inputPositions.begin(), inputPositions.end());
+
+  Real alpha[4];
+  const double cutOffFrequencies[4] = {2.0, 7.5, 7.5, 3.0};
+  for (int i = 0; i < 4; ++i)
+    {
+    alpha[i] = Kernels::BlendFactorFromCutOffFrequency(Real(cutOffFrequencies[i]), Real(TimeStep));
+    }
+  Kernels::SlerpCoefficients<Real> coefficients;
+  coefficients.Set(alpha[0], std::max(numberOfSlerpTerms, 0));
+  const Real toolFrame = Real(1);
+
+  Real quaternion[4] = {1, 0, 0, 0};
+  Real position[3] = {0, 0, 0};
+  Real settledQuaternion[4] = {1, 0, 0, 0};
+  Real settledPosition[3] = {0, 0, 0};
+  double maximumNormError = 0.0;
+  double maximumQuaternionDrift = 0.0;
+  double maximumPositionDrift = 0.0;
+  unsigned int stepsSinceNormalization = 0;
+  bool converged = false;
+  for (long long step = 0; step < numberOfSteps; ++step)
+    {
+    const int k = static_cast<int>(step % StepsPerPeriod);
+    const long long period = step / StepsPerPeriod;
+    const Real* inputQuaternion = &periodQuaternions[4*k];
+    const Real* inputPosition = &periodPositions[3*k];
+    Real previousQuaternion[4];
+    for (int i = 0; i < 4; ++i)
+      {
+      previousQuaternion[i] = quaternion[i];
+      }
+    if (period % PassThroughPeriodInterval == PassThroughPeriodInterval / 2 && k < PassThroughSteps)
+      {
+      Kernels::SetQuaternionInHemisphere(quaternion, inputQuaternion);
+      for (int i = 0; i < 3; ++i)
+        {
+        position[i] = inputPosition[i];
+        }
+      }
+    else
+      {
+      Kernels::FilterStep(Algorithm(), coefficients, alpha, toolFrame,
+                          inputQuaternion, inputPosition, quaternion, position);
+      Kernels::NormalizePeriodically(quaternion, stepsSinceNormalization, normalizationInterval);
+      converged = Kernels::SnapToInput(inputQuaternion, inputPosition, Real(PositionTolerance2),
+                                       Real(DotTolerance), quaternion, position);
+      }
+
+    double norm2 = 0.0;
+    double dot = 0.0;
+    for (int i = 0; i < 4; ++i)
+      {
+      norm2 += static_cast<double>(quaternion[i])*quaternion[i];
+      dot += static_cast<double>(quaternion[i])*previousQuaternion[i];
+      }
+    maximumNormError = std::max(maximumNormError, fabs(sqrt(norm2) - 1.0));
+    if (dot <= 0.0 && step > 0)
+      {
+      std::cerr << name << ": quaternion changed hemisphere at step " << step << std::endl;
+      return false;
+      }
+
+    if (k == StepsPerPeriod - 1 && !converged)
+      {
+      std::cerr << name << ": not converged to the still tool in period " << period << std::endl;
+      return false;
+      }
+    // Drift is measured while moving, the still pose is snapped to
+    if (k == StepsPerPeriod - StationarySteps - 1)
+      {
+      if (period == SettlingPeriods - 1)
+        {
+        for (int i = 0; i < 4; ++i)
+          {
+          settledQuaternion[i] = quaternion[i];
+          }
+        for (int i = 0; i < 3; ++i)
+          {
+          settledPosition[i] = position[i];
+          }
+        }
+      else if (period >= SettlingPeriods)
+        {
+        double positionDrift2 = 0.0;
+        for (int i = 0; i < 3; ++i)
+          {
+          positionDrift2 += (static_cast<double>(position[i]) - settledPosition[i])*
+            (static_cast<double>(position[i]) - settledPosition[i]);
+          }
+        maximumQuaternionDrift = std::max(maximumQuaternionDrift,
+                                          QuaternionDistance(quaternion, settledQuaternion));
+        maximumPositionDrift = std::max(maximumPositionDrift, sqrt(positionDrift2));
+        }
+      }
+    }
+
+  std::cout << name << ": " << numberOfSteps << " steps, largest norm error " << maximumNormError
+            << ", drift " << maximumQuaternionDrift << " (quaternion), "
+            << maximumPositionDrift << " mm" << std::endl;
+  bool success = true;
+  if (maximumNormError > normTolerance)
+    {
+    std::cerr << name << ": quaternion norm error " << maximumNormError
+              << " above " << normTolerance << std::endl;
+    success = false;
+    }
+  if (maximumQuaternionDrift > quaternionDriftTolerance)
+    {
+    std::cerr << name << ": quaternion drift " << maximumQuaternionDrift
+              << " above " << quaternionDriftTolerance << std::endl;
+    success = false;
+    }
+  if (maximumPositionDrift > positionDriftTolerance)
+    {
+    std::cerr << name << ": position drift " << maximumPositionDrift
+              << " mm above " << positionDriftTolerance << std::endl;
+    success = false;
+    }
+  return success;
+}
+
+} // end of anonymous namespace
+
+//-----------------------------------------------------------------------------
+// Long run of the filter kernels over a periodic input, without MRML.
+// The optional argument is the number of steps of each filter (100 million,
+// about 17 days of tracking at 15 ms, by default).
+int vtkSlicerTrackerStabilizerFilterKernelsSoakTest(int argc, char* argv[])
+{
+  long long numberOfSteps = 100000000LL;
+  if (argc > 1)
+    {
+    numberOfSteps = atoll(argv[1]);
+    }
+  if (numberOfSteps < (SettlingPeriods + 1)*StepsPerPeriod)
+    {
+    std::cerr << "At least " << (SettlingPeriods + 1)*StepsPerPeriod << " steps are needed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const int numberOfSlerpTerms = Kernels::SelectNumberOfSlerpTerms(1e-6);
+  bool success = true;
+  success = Soak<double, Kernels::LowPassFilter>("LowPass double", numberOfSteps, 0,
+    Kernels::NormalizationInterval, 1e-12, 1e-9, 1e-9) && success;
+  success = Soak<double, Kernels::FastLowPassFilter>("FastLowPass double", numberOfSteps, numberOfSlerpTerms,
+    Kernels::NormalizationInterval, 1e-6, 1e-9, 1e-9) && success;
+  success = Soak<float, Kernels::LowPassFilter>("LowPass float", numberOfSteps, 0,
+    1, 1e-6, 1e-4, 1e-3) && success;
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
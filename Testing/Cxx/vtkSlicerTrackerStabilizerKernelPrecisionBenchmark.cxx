@@ -0,0 +1,158 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// Benchmark of the batched low-pass kernel in single and double precision.
+// A batch of tools stored as structure of arrays is stepped towards fixed
+// inputs; reports the time per tool and step of both precisions, the
+// speedup, and the largest difference between the float and double poses.
+//
+// Usage: vtkSlicerTrackerStabilizerKernelPrecisionBenchmark [numberOfTools [numberOfSteps]]
+
+// TrackerStabilizer Logic includes
+#include "vtkSlicerTrackerStabilizerFilterKernels.h"
+
+// VTK includes
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace Kernels = vtkSlicerTrackerStabilizerFilterKernels;
+
+namespace
+{
+
+//-----------------------------------------------------------------------------
+// Batch of tools in structure of arrays, see FilterBatch
+template <typename Real>
+struct Batch
+{
+  explicit Batch(size_t numberOfTools)
+    : Alphas(4*numberOfTools), ToolFrames(numberOfTools),
+      InputQuaternions(4*numberOfTools), InputPositions(3*numberOfTools),
+      Quaternions(4*numberOfTools), Positions(3*numberOfTools)
+  {
+  }
+
+  std::vector<Real> Alphas;
+  std::vector<Real> ToolFrames;
+  std::vector<Real> InputQuaternions;
+  std::vector<Real> InputPositions;
+  std::vector<Real> Quaternions;
+  std::vector<Real> Positions;
+};
+
+//-----------------------------------------------------------------------------
+// Same tools in both precisions: the filter starts at the identity, the
+// inputs are rotations up to 90 degrees about various axes
+void InitializeBatches(size_t numberOfTools, Batch<double>& doubles, Batch<float>& floats)
+{
+  for (size_t i = 0; i < numberOfTools; ++i)
+    {
+    const double angle = 0.5*1.57 * (i % 97) / 96.0;
+    double axis[3] = { cos(0.1*i), sin(0.1*i), cos(0.37*i) };
+    const double norm = sqrt(axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2]);
+    const double quaternion[4] =
+      { cos(angle), sin(angle)*axis[0]/norm, sin(angle)*axis[1]/norm, sin(angle)*axis[2]/norm };
+    for (int c = 0; c < 4; ++c)
+      {
+      doubles.Alphas[c*numberOfTools + i] = 0.05 + 0.001*(i % 50);
+      doubles.InputQuaternions[c*numberOfTools + i] = quaternion[c];
+      doubles.Quaternions[c*numberOfTools + i] = (c == 0) ? 1.0 : 0.0;
+      }
+    for (int c = 0; c < 3; ++c)
+      {
+      doubles.InputPositions[c*numberOfTools + i] = 100.0*axis[c];
+      doubles.Positions[c*numberOfTools + i] = 0.0;
+      }
+    doubles.ToolFrames[i] = i % 2;
+    }
+  std::copy(doubles.Alphas.begin(), doubles.Alphas.end(), floats.Alphas.begin());
+  std::copy(doubles.ToolFrames.begin(), doubles.ToolFrames.end(), floats.ToolFrames.begin());
+  std::copy(doubles.InputQuaternions.begin(), doubles.InputQuaternions.end(), floats.InputQuaternions.begin());
+  std::copy(doubles.InputPositions.begin(), doubles.InputPositions.end(), floats.InputPositions.begin());
+  std::copy(doubles.Quaternions.begin(), doubles.Quaternions.end(), floats.Quaternions.begin());
+  std::copy(doubles.Positions.begin(), doubles.Positions.end(), floats.Positions.begin());
+}
+
+//-----------------------------------------------------------------------------
+// Mean time (s) per tool and step
+template <typename Real>
+double TimeSteps(Batch<Real>& batch, size_t numberOfTools, int numberOfSteps)
+{
+  const double start = vtkTimerLog::GetUniversalTime();
+  for (int step = 0; step < numberOfSteps; ++step)
+    {
+    Kernels::FilterBatch<Real, Kernels::LowPassFilter>(
+      0, numberOfTools, numberOfTools, &batch.Alphas[0], &batch.ToolFrames[0],
+      &batch.InputQuaternions[0], &batch.InputPositions[0],
+      &batch.Quaternions[0], &batch.Positions[0]);
+    }
+  return (vtkTimerLog::GetUniversalTime() - start) / (static_cast<double>(numberOfSteps)*numberOfTools);
+}
+
+} // end of anonymous namespace
+
+//-----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  const int numberOfTools = (argc > 1) ? atoi(argv[1]) : 4096;
+  const int numberOfSteps = (argc > 2) ? atoi(argv[2]) : 1000;
+  if (numberOfTools < 1 || numberOfSteps < 1)
+    {
+    std::cerr << "Usage: " << argv[0] << " [numberOfTools [numberOfSteps]]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const size_t count = static_cast<size_t>(numberOfTools);
+  Batch<double> doubles(count);
+  Batch<float> floats(count);
+  InitializeBatches(count, doubles, floats);
+  const double doubleTime = TimeSteps(doubles, count, numberOfSteps);
+  const double floatTime = TimeSteps(floats, count, numberOfSteps);
+
+  double maximumQuaternionError = 0.0;
+  double maximumPositionError = 0.0;
+  for (size_t i = 0; i < 4*count; ++i)
+    {
+    maximumQuaternionError = std::max(maximumQuaternionError,
+      fabs(doubles.Quaternions[i] - static_cast<double>(floats.Quaternions[i])));
+    }
+  for (size_t i = 0; i < 3*count; ++i)
+    {
+    maximumPositionError = std::max(maximumPositionError,
+      fabs(doubles.Positions[i] - static_cast<double>(floats.Positions[i])));
+    }
+
+  std::cout << "Tools: " << numberOfTools << ", steps: " << numberOfSteps << std::endl;
+  std::cout << "Double: " << doubleTime*1e9 << " ns per tool and step" << std::endl;
+  std::cout << "Float: " << floatTime*1e9 << " ns per tool and step" << std::endl;
+  std::cout << "Speedup: " << doubleTime / floatTime << std::endl;
+  std::cout << "Largest difference: " << maximumQuaternionError << " (quaternion), "
+            << maximumPositionError << " mm (position)" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,212 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// TrackerStabilizer Logic includes
+#include "vtkSlicerTrackerStabilizerLogic.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLTrackerStabilizerNode.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+//-----------------------------------------------------------------------------
+void SetPositionX(vtkMRMLLinearTransformNode* node, double x)
+{
+  vtkNew<vtkMatrix4x4> matrix;
+  matrix->SetElement(0, 3, x);
+  node->SetMatrixTransformToParent(matrix.GetPointer());
+}
+
+//-----------------------------------------------------------------------------
+double GetPositionX(vtkMRMLLinearTransformNode* node)
+{
+  vtkNew<vtkMatrix4x4> matrix;
+  node->GetMatrixTransformToParent(matrix.GetPointer());
+  return matrix->GetElement(0, 3);
+}
+
+//-----------------------------------------------------------------------------
+// Move the input along x by a constant step per tick and check that every
+// output update moves towards the input, by at most the distance to it:
+// the output never jumps away from the tool nor past it
+bool CheckContinuousOutput(vtkSlicerTrackerStabilizerLogic* logic,
+                           vtkMRMLLinearTransformNode* inputNode,
+                           vtkMRMLLinearTransformNode* outputNode,
+                           double& inputX, double step, int numberOfTicks, const char* context)
+{
+  for (int tick = 0; tick < numberOfTicks; ++tick)
+    {
+    const double previousOutputX = GetPositionX(outputNode);
+    inputX += step;
+    SetPositionX(inputNode, inputX);
+    logic->FilterActiveNodes();
+    const double outputX = GetPositionX(outputNode);
+    const double gap = inputX - previousOutputX;
+    const double move = outputX - previousOutputX;
+    if (move*gap < 0.0 || fabs(move) > fabs(gap) + 1e-9)
+      {
+      std::cerr << context << ", tick " << tick << ": output moved from " << previousOutputX
+                << " to " << outputX << " while the input is at " << inputX << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//-----------------------------------------------------------------------------
+// The output must not jump when a filter starts (warm start), when its
+// parameters change, and when its input node is replaced
+int vtkSlicerTrackerStabilizerLogicContinuityTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkNew<vtkMRMLScene> scene;
+  vtkNew<vtkSlicerTrackerStabilizerLogic> logic;
+  logic->SetMRMLScene(scene.GetPointer());
+
+  vtkNew<vtkMRMLLinearTransformNode> inputNode;
+  vtkNew<vtkMRMLLinearTransformNode> otherInputNode;
+  vtkNew<vtkMRMLLinearTransformNode> outputNode;
+  scene->AddNode(inputNode.GetPointer());
+  scene->AddNode(otherInputNode.GetPointer());
+  scene->AddNode(outputNode.GetPointer());
+  vtkNew<vtkMRMLTrackerStabilizerNode> tsNode;
+  scene->AddNode(tsNode.GetPointer());
+
+  // Warm start from the output: glides from the pose shown
+  double inputX = 100.0;
+  SetPositionX(inputNode.GetPointer(), inputX);
+  SetPositionX(outputNode.GetPointer(), 0.0);
+  tsNode->SetWarmStartMode(vtkMRMLTrackerStabilizerNode::WarmStartFromOutput);
+  tsNode->SetAndObserveInputTransformNodeID(inputNode->GetID());
+  tsNode->SetAndObserveFilteredTransformNodeID(outputNode->GetID());
+  logic->FilterActiveNodes();
+  const double firstOutputX = GetPositionX(outputNode.GetPointer());
+  if (firstOutputX <= 0.0 || firstOutputX >= 50.0)
+    {
+    std::cerr << "Warm start from the output: first output at " << firstOutputX
+              << ", expected a small step from 0 towards 100" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!CheckContinuousOutput(logic.GetPointer(), inputNode.GetPointer(), outputNode.GetPointer(),
+                             inputX, 0.0, 100, "Warm start from the output"))
+    {
+    return EXIT_FAILURE;
+    }
+
+  // Warm start from the input: the output starts where the tool is
+  tsNode->SetWarmStartMode(vtkMRMLTrackerStabilizerNode::WarmStartFromInput);
+  SetPositionX(otherInputNode.GetPointer(), -50.0);
+  tsNode->SetAndObserveInputTransformNodeID(otherInputNode->GetID());
+  logic->FilterActiveNodes();
+  if (GetPositionX(outputNode.GetPointer()) != -50.0)
+    {
+    std::cerr << "Warm start from the input: output at " << GetPositionX(outputNode.GetPointer())
+              << ", expected -50" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Moving tool: parameter changes only change the next steps
+  inputX = -50.0;
+  if (!CheckContinuousOutput(logic.GetPointer(), otherInputNode.GetPointer(), outputNode.GetPointer(),
+                             inputX, 1.0, 50, "Moving"))
+    {
+    return EXIT_FAILURE;
+    }
+  tsNode->SetCutOffFrequency(1.0);
+  if (!CheckContinuousOutput(logic.GetPointer(), otherInputNode.GetPointer(), outputNode.GetPointer(),
+                             inputX, 1.0, 50, "Lower cutoff frequency"))
+    {
+    return EXIT_FAILURE;
+    }
+  tsNode->SetCutOffFrequency(15.0);
+  if (!CheckContinuousOutput(logic.GetPointer(), otherInputNode.GetPointer(), outputNode.GetPointer(),
+                             inputX, 1.0, 50, "Higher cutoff frequency"))
+    {
+    return EXIT_FAILURE;
+    }
+  tsNode->MotionDetectionOn();
+  if (!CheckContinuousOutput(logic.GetPointer(), otherInputNode.GetPointer(), outputNode.GetPointer(),
+                             inputX, 1.0, 50, "Motion detection on"))
+    {
+    return EXIT_FAILURE;
+    }
+  tsNode->SetFilterActivated(false);
+  if (!CheckContinuousOutput(logic.GetPointer(), otherInputNode.GetPointer(), outputNode.GetPointer(),
+                             inputX, 1.0, 10, "Filter off"))
+    {
+    return EXIT_FAILURE;
+    }
+  tsNode->SetFilterActivated(true);
+  if (!CheckContinuousOutput(logic.GetPointer(), otherInputNode.GetPointer(), outputNode.GetPointer(),
+                             inputX, 1.0, 50, "Filter on again"))
+    {
+    return EXIT_FAILURE;
+    }
+
+  tsNode->MotionDetectionOff();
+  if (!CheckContinuousOutput(logic.GetPointer(), otherInputNode.GetPointer(), outputNode.GetPointer(),
+                             inputX, 1.0, 10, "Motion detection off"))
+    {
+    return EXIT_FAILURE;
+    }
+
+  // Input node replaced while warm starting from the output: glides from
+  // the last output to the new input. Motion detection is off so that the
+  // weight of the step does not depend on the time between ticks.
+  tsNode->SetWarmStartMode(vtkMRMLTrackerStabilizerNode::WarmStartFromOutput);
+  const double lastOutputX = GetPositionX(outputNode.GetPointer());
+  inputX = lastOutputX + 200.0;
+  SetPositionX(inputNode.GetPointer(), inputX);
+  tsNode->SetAndObserveInputTransformNodeID(inputNode->GetID());
+  if (!CheckContinuousOutput(logic.GetPointer(), inputNode.GetPointer(), outputNode.GetPointer(),
+                             inputX, 0.0, 1, "Input node replaced"))
+    {
+    return EXIT_FAILURE;
+    }
+  if (GetPositionX(outputNode.GetPointer()) - lastOutputX >= 100.0)
+    {
+    std::cerr << "Input node replaced: output jumped from " << lastOutputX << " to "
+              << GetPositionX(outputNode.GetPointer()) << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!CheckContinuousOutput(logic.GetPointer(), inputNode.GetPointer(), outputNode.GetPointer(),
+                             inputX, -1.0, 100, "After the input node was replaced"))
+    {
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,155 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// TrackerStabilizer Logic includes
+#include "vtkSlicerTrackerStabilizerLogic.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLTrackerStabilizerNode.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+//-----------------------------------------------------------------------------
+// The output of a filter whose input is unchanged and reached must not be
+// published again, and the motion state updates of the logic must not
+// modify the filter node (which would configure the filter again and
+// republish every tick).
+int vtkSlicerTrackerStabilizerLogicDirtyTrackingTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkNew<vtkMRMLScene> scene;
+  vtkNew<vtkSlicerTrackerStabilizerLogic> logic;
+  logic->SetMRMLScene(scene.GetPointer());
+
+  vtkNew<vtkMRMLLinearTransformNode> inputNode;
+  vtkNew<vtkMRMLLinearTransformNode> outputNode;
+  scene->AddNode(inputNode.GetPointer());
+  scene->AddNode(outputNode.GetPointer());
+  vtkNew<vtkMRMLTrackerStabilizerNode> tsNode;
+  tsNode->SetWarmStartMode(vtkMRMLTrackerStabilizerNode::WarmStartFromInput);
+  tsNode->MotionDetectionOn();
+  scene->AddNode(tsNode.GetPointer());
+  tsNode->SetAndObserveInputTransformNodeID(inputNode->GetID());
+  tsNode->SetAndObserveFilteredTransformNodeID(outputNode->GetID());
+  if (logic->GetNumberOfActiveFilters() != 1)
+    {
+    std::cerr << "Line " << __LINE__ << ": expected 1 active filter, got "
+              << logic->GetNumberOfActiveFilters() << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkNew<vtkMatrix4x4> matrix;
+  matrix->SetElement(0, 3, 10.0);
+  inputNode->SetMatrixTransformToParent(matrix.GetPointer());
+
+  // Warm started from the input: reached at the first sample
+  logic->FilterActiveNodes();
+  vtkNew<vtkMatrix4x4> output;
+  outputNode->GetMatrixTransformToParent(output.GetPointer());
+  if (output->GetElement(0, 3) != 10.0)
+    {
+    std::cerr << "Line " << __LINE__ << ": output not warm started, x = "
+              << output->GetElement(0, 3) << std::endl;
+    return EXIT_FAILURE;
+    }
+  unsigned long outputMTime = outputNode->GetMTime();
+  for (int i = 0; i < 10; ++i)
+    {
+    logic->FilterActiveNodes();
+    }
+  if (outputNode->GetMTime() != outputMTime)
+    {
+    std::cerr << "Line " << __LINE__ << ": unchanged input published again" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Fast motion: the motion state changes without modifying the node
+  const unsigned long nodeMTime = tsNode->GetMTime();
+  for (int i = 0; i < 20; ++i)
+    {
+    matrix->SetElement(0, 3, matrix->GetElement(0, 3) + 50.0);
+    inputNode->SetMatrixTransformToParent(matrix.GetPointer());
+    logic->FilterActiveNodes();
+    }
+  if (tsNode->GetMotionState() != vtkMRMLTrackerStabilizerNode::MotionFast)
+    {
+    std::cerr << "Line " << __LINE__ << ": motion state is "
+              << vtkMRMLTrackerStabilizerNode::GetMotionStateAsString(tsNode->GetMotionState())
+              << ", expected Fast" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (tsNode->GetMTime() != nodeMTime)
+    {
+    std::cerr << "Line " << __LINE__ << ": motion state update modified the node" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Stop: the output converges to the input, then is not published again
+  int numberOfTicks = 0;
+  do
+    {
+    outputMTime = outputNode->GetMTime();
+    logic->FilterActiveNodes();
+    }
+  while (outputNode->GetMTime() != outputMTime && ++numberOfTicks < 10000);
+  outputNode->GetMatrixTransformToParent(output.GetPointer());
+  if (numberOfTicks >= 10000 || output->GetElement(0, 3) != matrix->GetElement(0, 3))
+    {
+    std::cerr << "Line " << __LINE__ << ": output did not converge to the input, x = "
+              << output->GetElement(0, 3) << " instead of " << matrix->GetElement(0, 3) << std::endl;
+    return EXIT_FAILURE;
+    }
+  for (int i = 0; i < 10; ++i)
+    {
+    logic->FilterActiveNodes();
+    }
+  if (outputNode->GetMTime() != outputMTime)
+    {
+    std::cerr << "Line " << __LINE__ << ": converged output published again" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (tsNode->GetMTime() != nodeMTime)
+    {
+    std::cerr << "Line " << __LINE__ << ": filtering modified the node" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // A new input sample is filtered and published
+  matrix->SetElement(1, 3, 5.0);
+  inputNode->SetMatrixTransformToParent(matrix.GetPointer());
+  logic->FilterActiveNodes();
+  if (outputNode->GetMTime() == outputMTime)
+    {
+    std::cerr << "Line " << __LINE__ << ": modified input not published" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
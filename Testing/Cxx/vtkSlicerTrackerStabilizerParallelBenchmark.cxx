@@ -0,0 +1,126 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// Benchmark of FilterActiveNodes computed serially and on all cores, for 1
+// to 512 active filters whose inputs move every tick. Reports the time per
+// tick of both modes and the speedup.
+//
+// Usage: vtkSlicerTrackerStabilizerParallelBenchmark [numberOfTicks]
+
+// TrackerStabilizer Logic includes
+#include "vtkSlicerTrackerStabilizerLogic.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLTrackerStabilizerNode.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+//-----------------------------------------------------------------------------
+// Mean time (s) of FilterActiveNodes with all the inputs moving
+double TimeTicks(vtkSlicerTrackerStabilizerLogic* logic,
+                 std::vector<vtkSmartPointer<vtkMRMLLinearTransformNode> >& inputNodes,
+                 int numberOfTicks)
+{
+  vtkNew<vtkMatrix4x4> matrix;
+  const double start = vtkTimerLog::GetUniversalTime();
+  for (int tick = 0; tick < numberOfTicks; ++tick)
+    {
+    for (size_t i = 0; i < inputNodes.size(); ++i)
+      {
+      // Rotation about z and translation, different for each tool
+      const double angle = 0.01*tick + 0.1*i;
+      matrix->SetElement(0, 0, cos(angle));
+      matrix->SetElement(0, 1, -sin(angle));
+      matrix->SetElement(1, 0, sin(angle));
+      matrix->SetElement(1, 1, cos(angle));
+      matrix->SetElement(0, 3, 100.0*sin(angle));
+      inputNodes[i]->SetMatrixTransformToParent(matrix.GetPointer());
+      }
+    logic->FilterActiveNodes();
+    }
+  return (vtkTimerLog::GetUniversalTime() - start) / numberOfTicks;
+}
+
+} // end of anonymous namespace
+
+//-----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  const int numberOfTicks = (argc > 1) ? atoi(argv[1]) : 1000;
+  if (numberOfTicks < 1)
+    {
+    std::cerr << "Usage: " << argv[0] << " [numberOfTicks]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "Filters\tSerial (us)\tParallel (us)\tSpeedup" << std::endl;
+  for (int numberOfFilters = 1; numberOfFilters <= 512; numberOfFilters *= 2)
+    {
+    vtkNew<vtkMRMLScene> scene;
+    vtkNew<vtkSlicerTrackerStabilizerLogic> logic;
+    logic->SetMRMLScene(scene.GetPointer());
+    std::vector<vtkSmartPointer<vtkMRMLLinearTransformNode> > inputNodes;
+    for (int i = 0; i < numberOfFilters; ++i)
+      {
+      vtkSmartPointer<vtkMRMLLinearTransformNode> inputNode =
+        vtkSmartPointer<vtkMRMLLinearTransformNode>::New();
+      vtkSmartPointer<vtkMRMLLinearTransformNode> outputNode =
+        vtkSmartPointer<vtkMRMLLinearTransformNode>::New();
+      scene->AddNode(inputNode);
+      scene->AddNode(outputNode);
+      vtkSmartPointer<vtkMRMLTrackerStabilizerNode> tsNode =
+        vtkSmartPointer<vtkMRMLTrackerStabilizerNode>::New();
+      tsNode->MotionDetectionOn();
+      scene->AddNode(tsNode);
+      tsNode->SetAndObserveInputTransformNodeID(inputNode->GetID());
+      tsNode->SetAndObserveFilteredTransformNodeID(outputNode->GetID());
+      inputNodes.push_back(inputNode);
+      }
+
+    logic->SetNumberOfThreads(1);
+    TimeTicks(logic.GetPointer(), inputNodes, 10);
+    const double serialTime = TimeTicks(logic.GetPointer(), inputNodes, numberOfTicks);
+    logic->SetNumberOfThreads(0);
+    TimeTicks(logic.GetPointer(), inputNodes, 10);
+    const double parallelTime = TimeTicks(logic.GetPointer(), inputNodes, numberOfTicks);
+
+    std::cout << numberOfFilters << "\t" << serialTime*1e6 << "\t" << parallelTime*1e6
+              << "\t" << serialTime / parallelTime << std::endl;
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,197 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+ 
+==============================================================================*/
+
+
+// Qt includes
+#include <QPainter>
+#include <QPainterPath>
+
+#include "qSlicerTrackerStabilizerDiagnosticsWidget.h"
+
+#include "vtkSlicerTrackerStabilizerLogic.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+
+// STD includes
+#include <algorithm>
+#include <limits>
+
+//-----------------------------------------------------------------------------
+qSlicerTrackerStabilizerDiagnosticsWidget::qSlicerTrackerStabilizerDiagnosticsWidget(QWidget* _parent)
+  : Superclass( _parent )
+    , NumberOfSnapshots( 0 )
+{
+  this->setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+//-----------------------------------------------------------------------------
+qSlicerTrackerStabilizerDiagnosticsWidget::~qSlicerTrackerStabilizerDiagnosticsWidget()
+{
+}
+
+//-----------------------------------------------------------------------------
+QSize qSlicerTrackerStabilizerDiagnosticsWidget::sizeHint() const
+{
+  return QSize(400, 400);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerTrackerStabilizerDiagnosticsWidget::setSnapshots(vtkDoubleArray* snapshots)
+{
+  if (snapshots == NULL ||
+      snapshots->GetNumberOfComponents() != vtkSlicerTrackerStabilizerLogic::Diagnostics_Last)
+    {
+    this->clear();
+    return;
+    }
+  this->NumberOfSnapshots = static_cast<int>(snapshots->GetNumberOfTuples());
+  this->Snapshots.resize(this->NumberOfSnapshots * vtkSlicerTrackerStabilizerLogic::Diagnostics_Last);
+  if (this->NumberOfSnapshots > 0)
+    {
+    std::copy(snapshots->GetPointer(0), snapshots->GetPointer(0) + this->Snapshots.size(),
+              this->Snapshots.begin());
+    }
+  this->update();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerTrackerStabilizerDiagnosticsWidget::clear()
+{
+  this->NumberOfSnapshots = 0;
+  this->Snapshots.clear();
+  this->update();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerTrackerStabilizerDiagnosticsWidget::paintEvent(QPaintEvent* event)
+{
+  Q_UNUSED(event);
+  QPainter painter(this);
+  painter.fillRect(this->rect(), this->palette().base());
+  if (this->NumberOfSnapshots < 2)
+    {
+    painter.setPen(this->palette().color(QPalette::Text));
+    painter.drawText(this->rect(), Qt::AlignCenter, tr("No diagnostics"));
+    return;
+    }
+
+  typedef vtkSlicerTrackerStabilizerLogic Logic;
+  const QColor inputColor(160, 160, 160);
+  const QColor outputColors[3] = { QColor(220, 50, 50), QColor(50, 160, 50), QColor(50, 80, 220) };
+  const int numberOfPlots = 5;
+  const int plotHeight = this->height() / numberOfPlots;
+
+  for (int axis = 0; axis < 3; ++axis)
+    {
+    QVector<int> components;
+    components << Logic::DiagnosticsInputPositionX + axis << Logic::DiagnosticsOutputPositionX + axis;
+    QVector<QColor> colors;
+    colors << inputColor << outputColors[axis];
+    const QString title = tr("Position %1 (mm)").arg(QChar('X' + axis));
+    this->drawPlot(painter, QRect(0, axis*plotHeight, this->width(), plotHeight), title, components, colors);
+    }
+
+  QVector<int> components;
+  QVector<QColor> colors;
+  components << Logic::DiagnosticsInputAngle << Logic::DiagnosticsOutputAngle;
+  colors << inputColor << outputColors[0];
+  this->drawPlot(painter, QRect(0, 3*plotHeight, this->width(), plotHeight),
+                 tr("Angle (deg)"), components, colors);
+
+  // Rate and processing time have different units, side by side
+  const int halfWidth = this->width() / 2;
+  components.clear();
+  colors.clear();
+  components << Logic::DiagnosticsUpdateRate;
+  colors << outputColors[2];
+  this->drawPlot(painter, QRect(0, 4*plotHeight, halfWidth, plotHeight),
+                 tr("Update rate (Hz)"), components, colors);
+  components.clear();
+  components << Logic::DiagnosticsProcessingTime;
+  this->drawPlot(painter, QRect(halfWidth, 4*plotHeight, this->width() - halfWidth, plotHeight),
+                 tr("Processing time (s)"), components, colors);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerTrackerStabilizerDiagnosticsWidget::drawPlot(QPainter& painter, const QRect& rect,
+                                                         const QString& title,
+                                                         const QVector<int>& components,
+                                                         const QVector<QColor>& colors)
+{
+  const int stride = vtkSlicerTrackerStabilizerLogic::Diagnostics_Last;
+  const double* snapshots = this->Snapshots.constData();
+  const int count = this->NumberOfSnapshots;
+
+  double minimum = std::numeric_limits<double>::max();
+  double maximum = -std::numeric_limits<double>::max();
+  for (int i = 0; i < count; ++i)
+    {
+    for (int c = 0; c < components.size(); ++c)
+      {
+      const double value = snapshots[i*stride + components[c]];
+      minimum = std::min(minimum, value);
+      maximum = std::max(maximum, value);
+      }
+    }
+  if (maximum - minimum < 1e-9)
+    {
+    // Flat signal, centered
+    minimum -= 0.5;
+    maximum += 0.5;
+    }
+  const double startTime = snapshots[vtkSlicerTrackerStabilizerLogic::DiagnosticsTime];
+  const double endTime = snapshots[(count - 1)*stride + vtkSlicerTrackerStabilizerLogic::DiagnosticsTime];
+  const double duration = std::max(endTime - startTime, 1e-9);
+
+  const QRectF area = QRectF(rect).adjusted(4, 16, -4, -4);
+  painter.setPen(this->palette().color(QPalette::Mid));
+  painter.drawRect(area);
+  painter.setPen(this->palette().color(QPalette::Text));
+  painter.drawText(QRectF(rect).adjusted(4, 0, -4, 0), Qt::AlignLeft | Qt::AlignTop, title);
+  painter.drawText(QRectF(rect).adjusted(4, 0, -4, 0), Qt::AlignRight | Qt::AlignTop,
+                   QString("%1 .. %2").arg(minimum, 0, 'g', 4).arg(maximum, 0, 'g', 4));
+
+  painter.setRenderHint(QPainter::Antialiasing, true);
+  for (int c = 0; c < components.size(); ++c)
+    {
+    QPainterPath path;
+    for (int i = 0; i < count; ++i)
+      {
+      const double* snapshot = snapshots + i*stride;
+      const QPointF point(
+        area.left() + area.width() * (snapshot[vtkSlicerTrackerStabilizerLogic::DiagnosticsTime] - startTime) / duration,
+        area.bottom() - area.height() * (snapshot[components[c]] - minimum) / (maximum - minimum));
+      if (i == 0)
+        {
+        path.moveTo(point);
+        }
+      else
+        {
+        path.lineTo(point);
+        }
+      }
+    painter.setPen(QPen(colors[c], 1.0));
+    painter.drawPath(path);
+    }
+  painter.setRenderHint(QPainter::Antialiasing, false);
+}
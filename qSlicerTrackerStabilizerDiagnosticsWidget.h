@@ -0,0 +1,72 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+ 
+==============================================================================*/
+
+
+#ifndef __qSlicerTrackerStabilizerDiagnosticsWidget_h
+#define __qSlicerTrackerStabilizerDiagnosticsWidget_h
+
+// Qt includes
+#include <QVector>
+#include <QWidget>
+
+#include "qSlicerTrackerStabilizerModuleExport.h"
+
+class vtkDoubleArray;
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+/// Plots the diagnostics snapshots of a filter node over time: input and
+/// output position and rotation angle, update rate and processing time.
+class Q_SLICER_QTMODULES_TRACKERSTABILIZER_EXPORT qSlicerTrackerStabilizerDiagnosticsWidget :
+  public QWidget
+{
+  Q_OBJECT
+
+public:
+
+  typedef QWidget Superclass;
+  qSlicerTrackerStabilizerDiagnosticsWidget(QWidget *parent=0);
+  virtual ~qSlicerTrackerStabilizerDiagnosticsWidget();
+
+  virtual QSize sizeHint() const;
+
+public slots:
+
+  /// Copy the snapshots (as returned by the logic GetDiagnostics) and repaint
+  void setSnapshots(vtkDoubleArray* snapshots);
+  void clear();
+
+protected:
+
+  virtual void paintEvent(QPaintEvent* event);
+
+  /// Draw components of the snapshots in rect, with a common vertical scale
+  void drawPlot(QPainter& painter, const QRect& rect, const QString& title,
+                const QVector<int>& components, const QVector<QColor>& colors);
+
+  QVector<double> Snapshots;
+  int NumberOfSnapshots;
+
+private:
+  Q_DISABLE_COPY(qSlicerTrackerStabilizerDiagnosticsWidget);
+};
+
+#endif
@@ -35,6 +35,18 @@
 #include "vtkMRMLScene.h"
 #include "vtkMRMLTrackerStabilizerNode.h"
 
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkSmartPointer.h>
+
+namespace
+{
+// Diagnostics snapshots per second while the panel is expanded, and refresh
+// ticks between two repaints of the panel
+const double DiagnosticsRate = 30.0;
+const int DiagnosticsRefreshInterval = 5;
+}
+
 //-----------------------------------------------------------------------------
 /// \ingroup Slicer_QtModules_ExtensionTemplate
 class qSlicerTrackerStabilizerModuleWidgetPrivate: public Ui_qSlicerTrackerStabilizerModuleWidget
@@ -49,6 +61,8 @@ public:
   vtkSlicerTrackerStabilizerLogic* logic() const;
 
   QTimer* RefreshTimer;
+  vtkSmartPointer<vtkDoubleArray> DiagnosticsSnapshots;
+  int DiagnosticsRefreshCount;
 };
 
 //-----------------------------------------------------------------------------
@@ -58,6 +72,8 @@ public:
 qSlicerTrackerStabilizerModuleWidgetPrivate::qSlicerTrackerStabilizerModuleWidgetPrivate( qSlicerTrackerStabilizerModuleWidget& object) : q_ptr( &object )
 {
   this->RefreshTimer = new QTimer();
+  this->DiagnosticsSnapshots = vtkSmartPointer<vtkDoubleArray>::New();
+  this->DiagnosticsRefreshCount = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -119,6 +135,9 @@ void qSlicerTrackerStabilizerModuleWidget::setup()
   connect(d->FilteringValueWidget, SIGNAL(valueChanged(double)),
 	  this, SLOT(onCutOffFrequencyChanged(double)));
 
+  connect(d->DiagnosticsCollapsibleButton, SIGNAL(contentsCollapsed(bool)),
+	  this, SLOT(onDiagnosticsCollapsed(bool)));
+
   this->UpdateFromMRMLNode();
 }
 
@@ -196,20 +215,17 @@ void qSlicerTrackerStabilizerModuleWidget::onRefreshTimeout()
     return;
     }
 
-  vtkCollection* filteringNodes = this->mrmlScene()->GetNodesByClass("vtkMRMLTrackerStabilizerNode");
-  for (int i = 0; i < filteringNodes->GetNumberOfItems(); ++i)
+  d->logic()->FilterActiveNodes();
+
+  if (!d->DiagnosticsCollapsibleButton->collapsed() &&
+      ++d->DiagnosticsRefreshCount >= DiagnosticsRefreshInterval)
     {
+    d->DiagnosticsRefreshCount = 0;
     vtkMRMLTrackerStabilizerNode* tsNode = vtkMRMLTrackerStabilizerNode::SafeDownCast(
-      filteringNodes->GetItemAsObject(i));
-    if (tsNode == NULL)
-      {
-      return;
-      }
-
-    d->logic()->Filter(tsNode);
+      d->ModuleNodeComboBox->currentNode());
+    d->logic()->GetDiagnostics(tsNode, d->DiagnosticsSnapshots);
+    d->DiagnosticsWidget->setSnapshots(d->DiagnosticsSnapshots);
     }
-
-  filteringNodes->Delete();
 }
 
 //-----------------------------------------------------------------------------
@@ -325,6 +341,19 @@ void qSlicerTrackerStabilizerModuleWidget::onCutOffFrequencyChanged(double cutof
   tsNode->SetCutOffFrequency(cutoff);
 }
 
+//-----------------------------------------------------------------------------
+void qSlicerTrackerStabilizerModuleWidget::onDiagnosticsCollapsed(bool collapsed)
+{
+  Q_D(qSlicerTrackerStabilizerModuleWidget);
+
+  // Snapshots are only recorded, and filters only timed, while displayed
+  d->logic()->SetDiagnosticsRate(collapsed ? 0.0 : DiagnosticsRate);
+  if (collapsed)
+    {
+    d->DiagnosticsWidget->clear();
+    }
+}
+
 //-----------------------------------------------------------------------------
 void qSlicerTrackerStabilizerModuleWidget::UpdateFromMRMLNode()
 {
@@ -57,6 +57,7 @@ protected slots:
   void onInputNodeChanged();
   void onOutputNodeChanged();
   void onCutOffFrequencyChanged(double cutoff);
+  void onDiagnosticsCollapsed(bool collapsed);
   void UpdateFromMRMLNode();
 
 protected: